@@ -46,49 +46,7 @@ Type TypeFromString(const std::string_view& name)
 		return Type::get_void();
 	}
 
-	return Type{TYPE_UNKNOWN, "UnknownType"};
-}
-
-std::string_view TypeToString(Type data_type)
-{
-	if (data_type.IsPrimitive())
-	{
-		switch (data_type.id)
-		{
-		case TYPE_INT8:
-			return "i8";
-		case TYPE_INT16:
-			return "i16";
-		case TYPE_INT32:
-			return "i32";
-		case TYPE_INT64:
-			return "i64";
-		case TYPE_UINT8:
-			return "u8";
-		case TYPE_UINT16:
-			return "u16";
-		case TYPE_UINT32:
-			return "u32";
-		case TYPE_UINT64:
-			return "u64";
-		case TYPE_FLOAT:
-			return "f32";
-		case TYPE_DOUBLE:
-			return "f64";
-		case TYPE_BOOL:
-			return "bool";
-		case TYPE_STRING:
-			return "str";
-		case TYPE_CHAR:
-			return "char";
-		case TYPE_VOID:
-			return "void";
-		}
-	}
-	else
-	{
-		return data_type.name;
-	}
+	return Type{};
 }
 
 NumberLiteral::NumberLiteral(Value value)
@@ -111,8 +69,9 @@ ReturnStatement::ReturnStatement(Expression* expression)
 	this->node_type = ASTNodeType::ReturnStatement;
 }
 
-Parameter::Parameter(const std::string_view& name, Type data_type)
+Parameter::Parameter(const std::string_view& name, SymbolId symbol, Type data_type)
 	:name(name)
+	, symbol(symbol)
 	, data_type(data_type)
 {
 	this->node_type = ASTNodeType::Parameter;
@@ -125,31 +84,34 @@ Function::Function(FunctionPrototype* prototype, BlockNode* body)
 	this->node_type = ASTNodeType::Function;
 }
 
-Variable::Variable(const std::string_view& name, Type data_type)
+Variable::Variable(const std::string_view& name, SymbolId symbol, Type data_type)
 	:name(name)
+	, symbol(symbol)
 {
 	this->node_type = ASTNodeType::Variable;
 	this->data_type = data_type;
 }
 
-Program::Program(const std::vector<Function*>& functions, const std::vector<Statement*>& statements)
-	:functions(functions)
-	, statements(statements)
+Program::Program(std::vector<Function*> functions, std::vector<Statement*> statements)
+	:functions(std::move(functions))
+	, statements(std::move(statements))
 {
 	this->node_type = ASTNodeType::Program;
 }
 
-FunctionPrototype::FunctionPrototype(Type return_type, const std::string_view& name, const std::vector<Parameter>& params)
+FunctionPrototype::FunctionPrototype(Type return_type, const std::string_view& name, SymbolId symbol, std::vector<Parameter> params)
 	:return_type(return_type)
 	, name(name)
-	, params(params)
+	, symbol(symbol)
+	, params(std::move(params))
 {
 	this->node_type = ASTNodeType::FunctionPrototype;
 }
 
-CallExpression::CallExpression(const std::string_view& name, const std::vector<Argument*>& args)
+CallExpression::CallExpression(const std::string_view& name, SymbolId symbol, std::vector<Argument*> args)
 	:name(name)
-	, args(args)
+	, symbol(symbol)
+	, args(std::move(args))
 {
 	this->node_type = ASTNodeType::CallExpression;
 }
@@ -160,8 +122,8 @@ AssignmentStatement::AssignmentStatement(Expression* lhs, Expression* rhs)
 	this->node_type = ASTNodeType::AssignmentStatement;
 }
 
-CallStatement::CallStatement(std::string_view name, std::vector<Argument*> args)
-	: name(name), args(args)
+CallStatement::CallStatement(std::string_view name, SymbolId symbol, std::vector<Argument*> args)
+	: name(name), symbol(symbol), args(std::move(args))
 {
 	this->node_type = ASTNodeType::CallStatement;
 }
@@ -213,9 +175,9 @@ StringLiteral::StringLiteral(std::string_view value)
 	this->node_type = ASTNodeType::StringLiteral;
 }
 
-BlockNode::BlockNode(const std::vector<Statement*>& statements, size_t scope_id)
-	: statements(statements)
-	, scope_id(scope_id)
+BlockNode::BlockNode(std::vector<Statement*> statements, Scope* scope)
+	: statements(std::move(statements))
+	, scope(scope)
 {
 	this->node_type = ASTNodeType::BlockNode;
 }
@@ -244,13 +206,13 @@ ExternFunctionStatement::ExternFunctionStatement(std::string_view name, Function
 	this->node_type = ASTNodeType::ExternFunctionStatement;
 }
 
-StructField::StructField(std::string_view name, Type data_type)
-	: name(name), data_type(data_type)
+StructField::StructField(std::string_view name, SymbolId symbol, Type data_type)
+	: name(name), symbol(symbol), data_type(data_type)
 {
 }
 
-StructDefination::StructDefination(std::string_view name, const std::vector<StructField>& fields)
-	: name(name), fields(fields)
+StructDefination::StructDefination(std::string_view name, SymbolId symbol, std::vector<StructField> fields)
+	: name(name), symbol(symbol), fields(std::move(fields))
 {
 }
 
@@ -260,8 +222,8 @@ StructDefinationStatement::StructDefinationStatement(StructDefination* definatio
 	this->node_type = ASTNodeType::StructDefinationStatement;
 }
 
-MemberAccessExpression::MemberAccessExpression(Expression* lhs, std::string_view member)
-	: lhs(lhs), member(member)
+MemberAccessExpression::MemberAccessExpression(Expression* lhs, std::string_view member, SymbolId member_symbol)
+	: lhs(lhs), member(member), member_symbol(member_symbol)
 {
 	this->node_type = ASTNodeType::MemberAccessExpression;
 }
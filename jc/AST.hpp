@@ -50,23 +50,25 @@ struct ASTNode
 struct Parameter : public ASTNode
 {
 	std::string_view name;
+	SymbolId symbol;
 	Type data_type;
 
-	explicit Parameter(const std::string_view& name, Type data_type);
+	explicit Parameter(const std::string_view& name, SymbolId symbol, Type data_type);
 };
 
 struct FunctionPrototype : public ASTNode
 {
 	std::string_view name;
+	SymbolId symbol;
 	std::vector<Parameter> params;
 	Type return_type;
 
-	explicit FunctionPrototype(Type return_type, const std::string_view& name, const std::vector<Parameter>& params);
+	explicit FunctionPrototype(Type return_type, const std::string_view& name, SymbolId symbol, std::vector<Parameter> params);
 };
 
 struct Expression : public ASTNode
 {
-	Type data_type = Type{ TypeID::TYPE_UNKNOWN , ""};
+	Type data_type;
 };
 
 struct Argument : public Expression
@@ -139,9 +141,9 @@ struct Statement : public ASTNode
 struct BlockNode : public Statement
 {
 	std::vector<Statement*> statements;
-	size_t scope_id;
+	Scope* scope;
 
-	explicit BlockNode(const std::vector<Statement*>& statements, size_t scope_id);
+	explicit BlockNode(std::vector<Statement*> statements, Scope* scope);
 };
 
 struct ExpressionStatement : public Statement
@@ -162,6 +164,11 @@ struct Function : public ASTNode
 {
 	FunctionPrototype* prototype;
 	BlockNode* body;
+	// token of its "fn"
+	size_t begin = 0;
+	// tokens of the body from its "{" to one past its "}"
+	size_t body_begin = 0;
+	size_t body_end = 0;
 
 	explicit Function(FunctionPrototype* prototype, BlockNode* body);
 };
@@ -169,16 +176,22 @@ struct Function : public ASTNode
 struct CallExpression : public Expression
 {
 	std::string_view name;
+	SymbolId symbol;
 	std::vector<Argument*> args;
 
-	explicit CallExpression(const std::string_view& name, const std::vector<Argument*>& args);
+	explicit CallExpression(const std::string_view& name, SymbolId symbol, std::vector<Argument*> args);
 };
 
 struct Variable : public Expression
 {
 	std::string_view name;
+	SymbolId symbol;
+	// the declaration this name refers to is scope->variables[slot], filled in by
+	// the parser so later passes never look the name up again
+	Scope* scope = nullptr;
+	size_t slot = 0;
 
-	explicit Variable(const std::string_view& name, Type data_type);
+	explicit Variable(const std::string_view& name, SymbolId symbol, Type data_type);
 };
 
 struct Program : public ASTNode
@@ -186,7 +199,7 @@ struct Program : public ASTNode
 	std::vector<Function*> functions;
 	std::vector<Statement*> statements;
 
-	explicit Program(const std::vector<Function*>& functions, const std::vector<Statement*>& statements);
+	explicit Program(std::vector<Function*> functions, std::vector<Statement*> statements);
 };
 
 struct AssignmentStatement : public Statement
@@ -208,9 +221,10 @@ struct AssignmentExpression : public Expression
 struct CallStatement : public Statement
 {
 	std::string_view name;
+	SymbolId symbol;
 	std::vector<Argument*> args;
 	
-	explicit CallStatement(std::string_view name, std::vector<Argument*> args);
+	explicit CallStatement(std::string_view name, SymbolId symbol, std::vector<Argument*> args);
 };
 
 struct IfStatement : public Statement
@@ -267,21 +281,23 @@ struct ExternFunctionStatement : public Statement
 struct StructField
 {
 	std::string_view name;
+	SymbolId symbol = INVALID_SYMBOL;
 	Type data_type;
 
 	StructField() = default;
 
-	explicit StructField(std::string_view name, Type data_type);
+	explicit StructField(std::string_view name, SymbolId symbol, Type data_type);
 };
 
 struct StructDefination
 {
 	std::string_view name;
+	SymbolId symbol = INVALID_SYMBOL;
 	std::vector<StructField> fields;
 
 	StructDefination() = default;
 
-	explicit StructDefination(std::string_view name, const std::vector<StructField>& fields);
+	explicit StructDefination(std::string_view name, SymbolId symbol, std::vector<StructField> fields);
 };
 
 struct StructDefinationStatement : public Statement
@@ -295,9 +311,9 @@ struct MemberAccessExpression : public Expression
 {
 	Expression* lhs;
 	std::string_view member;
+	SymbolId member_symbol;
 
-	explicit MemberAccessExpression(Expression* lhs, std::string_view member);
+	explicit MemberAccessExpression(Expression* lhs, std::string_view member, SymbolId member_symbol);
 };
 
 Type TypeFromString(const std::string_view& name);
-std::string_view TypeToString(Type data_type);
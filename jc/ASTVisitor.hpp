@@ -0,0 +1,456 @@
+#pragma once
+#include <vector>
+#include <type_traits>
+#include <tuple>
+#include <utility>
+#include <cassert>
+#include "AST.hpp"
+#include "Context.hpp"
+
+// Walks the AST for a pass deriving from it (CRTP). A pass only writes hooks for the
+// node types it cares about, any of
+//
+//	bool Enter(T* node)                     before the children, false skips them (may return void)
+//	void BeforeChild(T* node, size_t index) before each child slot, also for empty ones
+//	void Leave(T* node)                     after the children
+//
+// where T is a concrete node type such as BinaryExpression. Hooks are resolved at compile
+// time, so there is no virtual call and node types without a hook cost nothing. Passes
+// that keep their hooks private have to befriend ASTVisitor<Pass>.
+//
+// Walk recurses with the node types known statically, so there is one switch per node.
+// Below MAX_RECURSIVE_WALK_DEPTH it hands the subtree to WalkIterative, which keeps its
+// own stack instead, so deeply nested input only grows a vector. Hooks may start a
+// nested walk.
+constexpr size_t MAX_RECURSIVE_WALK_DEPTH = 256;
+
+template<typename... Passes>
+class FusedPass;
+
+template<typename Derived>
+class ASTVisitor
+{
+public:
+	explicit ASTVisitor(Context* context)
+		: context(context)
+		, errors(&context->errors)
+		, warnings(&context->warnings)
+	{ }
+
+	// where the pass reports to, a pass running next to others gets lists of its own
+	void SetDiagnostics(std::vector<Message>* errors, std::vector<Message>* warnings)
+	{
+		this->errors = errors;
+		this->warnings = warnings;
+	}
+
+	// the semantic passes only look at function bodies
+	void WalkFunctions()
+	{
+		for (auto function : context->program->functions)
+		{
+			Walk(function);
+		}
+	}
+
+	void Walk(ASTNode* root)
+	{
+		if (root)
+		{
+			VisitNode(root, 0);
+		}
+	}
+
+	void WalkIterative(ASTNode* root)
+	{
+		if (root == nullptr)
+		{
+			return;
+		}
+
+		// frames above `base` belong to this walk, anything below to a walk that called us
+		const size_t base = walk_stack.size();
+		PushNode(root);
+		while (walk_stack.size() > base)
+		{
+			auto& frame = walk_stack.back();
+			auto node = frame.node;
+			if (frame.next_child < frame.child_count)
+			{
+				// hooks may walk too, so the frame is not touched after calling one
+				auto index = frame.next_child++;
+				BeforeChildNode(node, index);
+				if (auto child = GetChild(node, index))
+				{
+					PushNode(child);
+				}
+			}
+			else
+			{
+				walk_stack.pop_back();
+				LeaveNode(node);
+			}
+		}
+	}
+
+protected:
+	void Error(const std::string& text, size_t line, size_t column)
+	{
+		errors->push_back(Message{ text, line, column });
+	}
+
+	void Warning(const std::string& text, size_t line, size_t column)
+	{
+		if (context->print_warings)
+		{
+			warnings->push_back(Message{ text, line, column });
+		}
+	}
+
+	Context* context;
+	std::vector<Message>* errors;
+	std::vector<Message>* warnings;
+
+private:
+	template<typename... Passes>
+	friend class FusedPass;
+
+	struct Frame
+	{
+		ASTNode* node;
+		size_t next_child;
+		size_t child_count;
+	};
+
+	Derived& Self() { return static_cast<Derived&>(*this); }
+
+	// calls f with the node cast to its concrete type
+	template<typename F>
+	static decltype(auto) Dispatch(ASTNode* node, F&& f)
+	{
+		switch (node->node_type)
+		{
+		case ASTNodeType::Program: return f(static_cast<Program*>(node));
+		case ASTNodeType::Function: return f(static_cast<Function*>(node));
+		case ASTNodeType::BlockNode: return f(static_cast<BlockNode*>(node));
+		case ASTNodeType::ExpressionStatement: return f(static_cast<ExpressionStatement*>(node));
+		case ASTNodeType::ReturnStatement: return f(static_cast<ReturnStatement*>(node));
+		case ASTNodeType::DeclarationStatement: return f(static_cast<DeclarationStatement*>(node));
+		case ASTNodeType::AssignmentStatement: return f(static_cast<AssignmentStatement*>(node));
+		case ASTNodeType::CallStatement: return f(static_cast<CallStatement*>(node));
+		case ASTNodeType::IfStatement: return f(static_cast<IfStatement*>(node));
+		case ASTNodeType::ForStatement: return f(static_cast<ForStatement*>(node));
+		case ASTNodeType::CppBlock: return f(static_cast<CppBlock*>(node));
+		case ASTNodeType::ExternVariableStatement: return f(static_cast<ExternVariableStatement*>(node));
+		case ASTNodeType::ExternFunctionStatement: return f(static_cast<ExternFunctionStatement*>(node));
+		case ASTNodeType::StructDefinationStatement: return f(static_cast<StructDefinationStatement*>(node));
+		case ASTNodeType::NumberLiteral: return f(static_cast<NumberLiteral*>(node));
+		case ASTNodeType::StringLiteral: return f(static_cast<StringLiteral*>(node));
+		case ASTNodeType::Variable: return f(static_cast<Variable*>(node));
+		case ASTNodeType::CallExpression: return f(static_cast<CallExpression*>(node));
+		case ASTNodeType::BinaryExpression: return f(static_cast<BinaryExpression*>(node));
+		case ASTNodeType::UnaryExpression: return f(static_cast<UnaryExpression*>(node));
+		case ASTNodeType::AssignmentExpression: return f(static_cast<AssignmentExpression*>(node));
+		case ASTNodeType::Argument: return f(static_cast<Argument*>(node));
+		case ASTNodeType::MemberAccessExpression: return f(static_cast<MemberAccessExpression*>(node));
+		default:
+			assert(false);
+			__assume(false);
+		}
+	}
+
+	// which hooks the pass has, looked up in the pass only so the helpers below
+	// are never mistaken for one
+	template<typename Node>
+	static constexpr bool HAS_ENTER = requires(Derived& pass, Node* node) { pass.Enter(node); };
+	template<typename Node>
+	static constexpr bool HAS_BEFORE_CHILD = requires(Derived& pass, Node* node) { pass.BeforeChild(node, size_t{}); };
+	template<typename Node>
+	static constexpr bool HAS_LEAVE = requires(Derived& pass, Node* node) { pass.Leave(node); };
+
+	// a pass without any hook of a kind does not pay for dispatching it
+	template<typename... Nodes>
+	struct NodeList
+	{
+		static constexpr bool ANY_BEFORE_CHILD = (HAS_BEFORE_CHILD<Nodes> || ...);
+		static constexpr bool ANY_LEAVE = (HAS_LEAVE<Nodes> || ...);
+	};
+
+	using AllNodes = NodeList<Program, Function, BlockNode, ExpressionStatement, ReturnStatement,
+		DeclarationStatement, AssignmentStatement, CallStatement, IfStatement, ForStatement, CppBlock,
+		ExternVariableStatement, ExternFunctionStatement, StructDefinationStatement, NumberLiteral,
+		StringLiteral, Variable, CallExpression, BinaryExpression, UnaryExpression, AssignmentExpression,
+		Argument, MemberAccessExpression>;
+
+	template<typename Node>
+	bool EnterTyped(Node* node)
+	{
+		if constexpr (HAS_ENTER<Node>)
+		{
+			if constexpr (std::is_void_v<decltype(Self().Enter(node))>)
+			{
+				Self().Enter(node);
+			}
+			else
+			{
+				return Self().Enter(node);
+			}
+		}
+		return true;
+	}
+
+	template<typename Node>
+	void LeaveTyped(Node* node)
+	{
+		if constexpr (HAS_LEAVE<Node>)
+		{
+			Self().Leave(node);
+		}
+	}
+
+	template<typename Node>
+	void BeforeChildTyped(Node* node, size_t index)
+	{
+		if constexpr (HAS_BEFORE_CHILD<Node>)
+		{
+			Self().BeforeChild(node, index);
+		}
+	}
+
+	template<typename Node>
+	void VisitTyped(Node* node, size_t depth)
+	{
+		if (!EnterTyped(node))
+		{
+			return;
+		}
+
+		const size_t child_count = ChildCount(node);
+		for (size_t i = 0; i < child_count; i++)
+		{
+			BeforeChildTyped(node, i);
+			if (auto child = GetChildTyped(node, i))
+			{
+				VisitNode(child, depth + 1);
+			}
+		}
+
+		LeaveTyped(node);
+	}
+
+	void VisitNode(ASTNode* node, size_t depth)
+	{
+		if (depth >= MAX_RECURSIVE_WALK_DEPTH) [[unlikely]]
+		{
+			WalkIterative(node);
+			return;
+		}
+
+		Dispatch(node, [this, depth](auto typed) { VisitTyped(typed, depth); });
+	}
+
+	// enters a node for WalkIterative and either finishes it right away when it has no
+	// children or pushes it, one dispatch on its type covers both
+	void PushNode(ASTNode* node)
+	{
+		Dispatch(node, [this](auto typed)
+		{
+			if (!EnterTyped(typed))
+			{
+				return;
+			}
+
+			auto child_count = ChildCount(typed);
+			if (child_count == 0)
+			{
+				LeaveTyped(typed);
+			}
+			else
+			{
+				walk_stack.push_back({ typed, 0, child_count });
+			}
+		});
+	}
+
+	void BeforeChildNode(ASTNode* node, size_t index)
+	{
+		if constexpr (AllNodes::ANY_BEFORE_CHILD)
+		{
+			Dispatch(node, [this, index](auto typed) { BeforeChildTyped(typed, index); });
+		}
+	}
+
+	void LeaveNode(ASTNode* node)
+	{
+		if constexpr (AllNodes::ANY_LEAVE)
+		{
+			Dispatch(node, [this](auto typed) { LeaveTyped(typed); });
+		}
+	}
+
+	// child slots are fixed per node type, optional children are nullptr and skipped
+	template<typename Node>
+	static size_t ChildCount(Node* node)
+	{
+		if constexpr (std::is_same_v<Node, Program>)
+			return node->statements.size() + node->functions.size();
+		else if constexpr (std::is_same_v<Node, BlockNode>)
+			return node->statements.size();
+		else if constexpr (std::is_same_v<Node, CallStatement> || std::is_same_v<Node, CallExpression>)
+			return node->args.size();
+		else if constexpr (std::is_same_v<Node, Function> || std::is_same_v<Node, ExpressionStatement> ||
+			std::is_same_v<Node, ReturnStatement> || std::is_same_v<Node, DeclarationStatement> ||
+			std::is_same_v<Node, UnaryExpression> || std::is_same_v<Node, Argument> ||
+			std::is_same_v<Node, MemberAccessExpression>)
+			return 1;
+		else if constexpr (std::is_same_v<Node, AssignmentStatement> || std::is_same_v<Node, BinaryExpression> ||
+			std::is_same_v<Node, AssignmentExpression>)
+			return 2;
+		else if constexpr (std::is_same_v<Node, IfStatement>)
+			return 3;
+		else if constexpr (std::is_same_v<Node, ForStatement>)
+			return 4;
+		else
+			return 0;
+	}
+
+	template<typename Node>
+	ASTNode* GetChildTyped(Node* node, size_t index)
+	{
+		if constexpr (std::is_same_v<Node, Program>)
+		{
+			if (index < node->statements.size())
+				return node->statements[index];
+			return node->functions[index - node->statements.size()];
+		}
+		// lazily parsed bodies are parsed here, the first time a pass walks into them
+		else if constexpr (std::is_same_v<Node, Function>)
+			return context->GetFunctionBody(node);
+		else if constexpr (std::is_same_v<Node, BlockNode>)
+			return node->statements[index];
+		else if constexpr (std::is_same_v<Node, CallStatement> || std::is_same_v<Node, CallExpression>)
+			return node->args[index];
+		else if constexpr (std::is_same_v<Node, ExpressionStatement> || std::is_same_v<Node, ReturnStatement> ||
+			std::is_same_v<Node, DeclarationStatement> || std::is_same_v<Node, UnaryExpression> ||
+			std::is_same_v<Node, Argument>)
+			return node->expression;
+		else if constexpr (std::is_same_v<Node, MemberAccessExpression>)
+			return node->lhs;
+		else if constexpr (std::is_same_v<Node, AssignmentStatement> || std::is_same_v<Node, BinaryExpression> ||
+			std::is_same_v<Node, AssignmentExpression>)
+			return index == 0 ? node->lhs : node->rhs;
+		else if constexpr (std::is_same_v<Node, IfStatement>)
+		{
+			ASTNode* children[] = { node->condition, node->if_body, node->else_body };
+			return children[index];
+		}
+		else if constexpr (std::is_same_v<Node, ForStatement>)
+		{
+			ASTNode* children[] = { node->intialization, node->condition, node->inc, node->body };
+			return children[index];
+		}
+		else
+		{
+			assert(false);
+			return nullptr;
+		}
+	}
+
+	ASTNode* GetChild(ASTNode* node, size_t index)
+	{
+		return Dispatch(node, [this, index](auto typed) { return GetChildTyped(typed, index); });
+	}
+
+	std::vector<Frame> walk_stack;
+};
+
+// Runs the hooks of several passes in a single walk, so the tree is only read once. For
+// each node the passes run in the order they are listed, a later pass sees what the
+// earlier ones did to that node and everything below it. A pass that prunes a subtree
+// in Enter gets no hooks for it while the others still walk it.
+template<typename... Passes>
+class FusedPass : public ASTVisitor<FusedPass<Passes...>>
+{
+public:
+	explicit FusedPass(Context* context)
+		: ASTVisitor<FusedPass<Passes...>>(context)
+		, passes(Passes(context)...)
+	{ }
+
+	void SetDiagnostics(std::vector<Message>* errors, std::vector<Message>* warnings)
+	{
+		ASTVisitor<FusedPass<Passes...>>::SetDiagnostics(errors, warnings);
+		ForEachPass([&](auto& pass, ASTNode*&) { pass.SetDiagnostics(errors, warnings); });
+	}
+
+private:
+	friend class ASTVisitor<FusedPass<Passes...>>;
+
+	template<typename F>
+	void ForEachPass(F&& f)
+	{
+		[&]<size_t... I>(std::index_sequence<I...>)
+		{
+			(f(static_cast<ASTVisitor<Passes>&>(std::get<I>(passes)), pruned[I]), ...);
+		}(std::index_sequence_for<Passes...>{});
+	}
+
+	template<typename Node>
+	bool Enter(Node* node)
+	{
+		bool any_entered = false;
+		ForEachPass([&](auto& pass, ASTNode*& pruned_at)
+		{
+			if (pruned_at == nullptr && !pass.EnterTyped(node))
+			{
+				pruned_at = node;
+			}
+			any_entered |= pruned_at == nullptr;
+		});
+
+		// nobody walks into it, so there is no Leave to clear the marks set here
+		if (!any_entered)
+		{
+			ForEachPass([&](auto&, ASTNode*& pruned_at)
+			{
+				if (pruned_at == node)
+				{
+					pruned_at = nullptr;
+				}
+			});
+		}
+		return any_entered;
+	}
+
+	template<typename Node>
+	void BeforeChild(Node* node, size_t index)
+	{
+		ForEachPass([&](auto& pass, ASTNode*& pruned_at)
+		{
+			if (pruned_at == nullptr)
+			{
+				pass.BeforeChildTyped(node, index);
+			}
+		});
+	}
+
+	template<typename Node>
+	void Leave(Node* node)
+	{
+		ForEachPass([&](auto& pass, ASTNode*& pruned_at)
+		{
+			if (pruned_at == node)
+			{
+				pruned_at = nullptr;
+			}
+			else if (pruned_at == nullptr)
+			{
+				pass.LeaveTyped(node);
+			}
+		});
+	}
+
+	std::tuple<Passes...> passes;
+	// the node each pass pruned at, nullptr while it is walking
+	ASTNode* pruned[sizeof...(Passes)] = {};
+};
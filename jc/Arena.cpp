@@ -0,0 +1,111 @@
+#include "Arena.hpp"
+#include <cassert>
+
+static size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+Arena::Arena(size_t block_size)
+	: block_size(block_size)
+{
+}
+
+Arena::~Arena()
+{
+	RunDestructors();
+
+	while (current)
+	{
+		auto next = current->next;
+		::operator delete(current);
+		current = next;
+	}
+}
+
+void* Arena::Allocate(size_t size, size_t alignment)
+{
+	assert((alignment & (alignment - 1)) == 0);
+
+	if (current)
+	{
+		auto base = reinterpret_cast<uintptr_t>(current + 1);
+		auto offset = AlignUp(base + current->used, alignment) - base;
+		if (offset + size <= current->size)
+		{
+			current->used = offset + size;
+			bytes_used += size;
+			return reinterpret_cast<void*>(base + offset);
+		}
+	}
+
+	auto block = AllocateBlock(size + alignment);
+	auto base = reinterpret_cast<uintptr_t>(block + 1);
+	auto offset = AlignUp(base, alignment) - base;
+	block->used = offset + size;
+	bytes_used += size;
+	return reinterpret_cast<void*>(base + offset);
+}
+
+void Arena::Reset()
+{
+	RunDestructors();
+
+	if (!current)
+		return;
+
+	// keep only the oldest block, it is the one every compilation starts filling
+	while (current->next)
+	{
+		auto next = current->next;
+		::operator delete(current);
+		current = next;
+		block_count--;
+	}
+
+	current->used = 0;
+	bytes_used = 0;
+}
+
+Arena::Block* Arena::AllocateBlock(size_t minimum_size)
+{
+	auto size = minimum_size > block_size ? minimum_size : block_size;
+	auto block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+	block->size = size;
+	block->used = 0;
+
+	if (current && minimum_size > block_size)
+	{
+		// oversized allocations get a block of their own behind the current one,
+		// so the remaining space of the current block is not thrown away
+		block->next = current->next;
+		current->next = block;
+	}
+	else
+	{
+		block->next = current;
+		current = block;
+	}
+
+	block_count++;
+	return block;
+}
+
+void Arena::RegisterDestructor(void* object, void (*destroy)(void*))
+{
+	auto destructor = static_cast<Destructor*>(Allocate(sizeof(Destructor), alignof(Destructor)));
+	destructor->destroy = destroy;
+	destructor->object = object;
+	destructor->next = destructors;
+	destructors = destructor;
+}
+
+void Arena::RunDestructors()
+{
+	// newest first, same order as stack unwinding
+	while (destructors)
+	{
+		destructors->destroy(destructors->object);
+		destructors = destructors->next;
+	}
+}
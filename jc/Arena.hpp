@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator that owns the front-end objects (AST nodes, scopes, variables, types).
+// Nothing is freed individually, everything goes away at once in Reset() or the destructor.
+class Arena
+{
+public:
+	explicit Arena(size_t block_size = 1024 * 1024);
+	~Arena();
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	template<typename T, typename... Args>
+	T* New(Args&&... args)
+	{
+		void* memory = Allocate(sizeof(T), alignof(T));
+		T* object = new (memory) T(std::forward<Args>(args)...);
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			// nodes holding std::vector etc. still need their destructors to run on reset
+			RegisterDestructor(object, [](void* pointer) { static_cast<T*>(pointer)->~T(); });
+		}
+		return object;
+	}
+
+	// runs the pending destructors and rewinds to the first block so the memory can be reused
+	void Reset();
+
+	size_t GetBytesUsed() const { return bytes_used; }
+	size_t GetBlockCount() const { return block_count; }
+
+private:
+	struct Block
+	{
+		Block* next;
+		size_t size;
+		size_t used;
+	};
+
+	struct Destructor
+	{
+		void (*destroy)(void*);
+		void* object;
+		Destructor* next;
+	};
+
+	Block* AllocateBlock(size_t minimum_size);
+	void RegisterDestructor(void* object, void (*destroy)(void*));
+	void RunDestructors();
+
+	Block* current = nullptr;
+	Destructor* destructors = nullptr;
+	size_t block_size;
+	size_t bytes_used = 0;
+	size_t block_count = 0;
+};
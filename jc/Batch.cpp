@@ -0,0 +1,84 @@
+#include "Batch.hpp"
+#include "Utils.hpp"
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+Batch::Batch(std::vector<const char*> file_paths, size_t thread_count, std::function<void(Context*)> configure)
+	: thread_count(thread_count)
+	, configure(std::move(configure))
+{
+	for (auto path : file_paths)
+	{
+		File file;
+		file.path = path;
+		file.output_path = std::filesystem::path(path).replace_extension(".cpp").string();
+		files.push_back(std::move(file));
+	}
+}
+
+bool Batch::Run()
+{
+	auto batch_start = get_time();
+
+	ThreadPool pool(thread_count);
+	// created by the first file a worker gets, reset for every file after that
+	std::vector<std::unique_ptr<Context>> contexts(pool.ThreadCount());
+	pool.ParallelForStealing(files.size(), [&](size_t worker, size_t index)
+	{
+		auto& context = contexts[worker];
+		if (context)
+		{
+			context->Reset(files[index].path);
+		}
+		else
+		{
+			context = std::make_unique<Context>(files[index].path);
+		}
+		CompileFile(context.get(), files[index]);
+	});
+
+	bool failed = false;
+	for (auto& file : files)
+	{
+		if (!file.messages.empty())
+		{
+			std::cout << "In " << file.path << ":" << std::endl << file.messages;
+		}
+		failed |= file.failed;
+	}
+
+	if (print_timing)
+	{
+		std::cout << "Batch Took: " << get_time_diff_ms(batch_start) << "ms (" << files.size() << " files, "
+			<< pool.ThreadCount() << " threads)" << std::endl;
+	}
+	return !failed;
+}
+
+void Batch::CompileFile(Context* context, File& file)
+{
+	configure(context);
+	// files already run next to each other, a compile starting threads of its own would
+	// only take them from other files
+	context->thread_count = 1;
+	context->print_timing = false;
+	context->output_path = file.output_path.c_str();
+
+	std::ostringstream messages;
+	if (context->stream_tokens)
+	{
+		auto lock = module_locks.Lock(file.path);
+		context->Compile();
+		context->PrintMessages(messages);
+		file.failed = !context->errors.empty();
+	}
+	else
+	{
+		ModuleGraph graph(context, &module_locks);
+		graph.Build();
+		graph.PrintMessages(messages);
+		file.failed = graph.HasErrors();
+	}
+	file.messages = messages.str();
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "Context.hpp"
+#include "ModuleGraph.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compiles many files in one process, each one as if it was given on the command line
+// alone, into <name>.cpp next to it. Files are spread over a pool and every thread keeps
+// one Context that is reset between its files, so arena blocks and table capacity are
+// paid for once per thread instead of once per file. Tables that never change, keywords
+// and primitive types, are constants every thread reads.
+// Messages are held per file and printed in the order the files were given. A module
+// imported by several files, or a file given twice, is written by one of them at a time,
+// the others find it current once it is done.
+class Batch
+{
+public:
+	// `configure` sets the options of a context before each file, it runs on the workers
+	Batch(std::vector<const char*> file_paths, size_t thread_count, std::function<void(Context*)> configure);
+
+	// false when any file had errors
+	bool Run();
+
+	// the time of the whole batch, the files themselves never print theirs
+	bool print_timing = false;
+
+private:
+	struct File
+	{
+		const char* path;
+		std::string output_path;
+		std::string messages;
+		bool failed = false;
+	};
+
+	void CompileFile(Context* context, File& file);
+
+	std::vector<File> files;
+	size_t thread_count;
+	std::function<void(Context*)> configure;
+	ModuleLocks module_locks;
+};
@@ -0,0 +1,208 @@
+#include "Bench.hpp"
+#include "Context.hpp"
+#include "Lexer.hpp"
+#include "LexerKernels.hpp"
+#include "Parser.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// the best of a few runs, the first one also pays for faulting the input in
+constexpr size_t BENCH_RUNS = 3;
+
+static double MegabytesPerSecond(size_t size, uint64_t ns)
+{
+	return ns ? size / (ns / 1e9) / 1e6 : 0;
+}
+
+Bench::Bench(std::vector<const char*> args)
+	: args(std::move(args))
+{
+}
+
+bool Bench::Run()
+{
+	if (!args.empty() && std::strcmp(args[0], "lexer") == 0)
+	{
+		BenchLexerKernels();
+		return BenchLexer(args.size() > 1 ? args[1] : nullptr);
+	}
+	if (!args.empty() && std::strcmp(args[0], "parser") == 0)
+	{
+		return BenchParser(args.size() > 1 ? std::strtoul(args[1], nullptr, 10) : 100000);
+	}
+
+	std::cout << "Error: --bench takes lexer [file] or parser [operands]" << std::endl;
+	return false;
+}
+
+void Bench::BenchLexerKernels()
+{
+	std::string text;
+	while (text.size() < (64u << 20))
+	{
+		text += "\n\n\t\t\t\t        \n\t\t";
+		text += "averyveryverylongidentifiername0123456789abcdefghijkl";
+		text += "// a fairly long comment that goes on for a while, like real comments do in code\n";
+	}
+
+	for (auto name : { "scalar", "sse2", "avx2" })
+	{
+		auto kernels = FindLexerKernels(name);
+		if (!kernels)
+		{
+			continue;
+		}
+
+		uint64_t best = UINT64_MAX;
+		size_t newlines = 0;
+		for (size_t run = 0; run < BENCH_RUNS; ++run)
+		{
+			auto start = get_time();
+			newlines = 0;
+			const char* p = text.data();
+			auto end = p + text.size();
+			while (p < end)
+			{
+				auto whitespace = kernels->skip_whitespace(p, end);
+				newlines += whitespace.newlines;
+				p += whitespace.length;
+				p += kernels->identifier_length(p, end);
+				p = kernels->find_newline(p, end);
+			}
+			best = std::min(best, get_time_diff_ns(start));
+		}
+		// the count keeps the loop from being optimized away, and has to be the same for every set
+		std::cout << "Lexer Kernels " << name << ": " << (uint64_t)MegabytesPerSecond(text.size(), best) << " MB/s ("
+			<< newlines << " newlines)" << std::endl;
+	}
+}
+
+bool Bench::BenchLexer(const char* path)
+{
+	// a generated program goes through a file like any other input, mapped and all
+	auto input_path = path ? std::string(path) : WriteInput("jc_bench.jin", GenerateProgram(200000));
+	if (input_path.empty())
+	{
+		return false;
+	}
+
+	Context context(input_path.c_str());
+	if (!context.errors.empty())
+	{
+		context.PrintMessages();
+		return false;
+	}
+
+	uint64_t best = UINT64_MAX;
+	for (size_t run = 0; run < BENCH_RUNS; ++run)
+	{
+		context.Reset(input_path.c_str());
+		auto start = get_time();
+		Lexer(&context).Lex();
+		best = std::min(best, get_time_diff_ns(start));
+	}
+	std::cout << "Lexer " << GetLexerKernels().name << ": " << (uint64_t)MegabytesPerSecond(context.input.size(), best)
+		<< " MB/s (" << context.input.size() << " bytes, " << context.tokens.Count() << " tokens)" << std::endl;
+
+	// everything from reading the file to writing the generated code
+	auto output_path = (std::filesystem::temp_directory_path() / "jc_bench.cpp").string();
+	context.Reset(input_path.c_str());
+	context.output_path = output_path.c_str();
+	auto start = get_time();
+	context.Compile();
+	auto compile_ns = get_time_diff_ns(start);
+	std::cout << "Compile: " << compile_ns / 1000000 << "ms, " << (uint64_t)MegabytesPerSecond(context.input.size(), compile_ns)
+		<< " MB/s (" << context.errors.size() << " errors)" << std::endl;
+
+	std::error_code error;
+	std::filesystem::remove(output_path, error);
+	if (!path)
+	{
+		std::filesystem::remove(input_path, error);
+	}
+	return true;
+}
+
+bool Bench::BenchParser(size_t operand_count)
+{
+	auto input_path = WriteInput("jc_bench_parser.jin", GenerateExpression(std::max<size_t>(operand_count, 1)));
+	if (input_path.empty())
+	{
+		return false;
+	}
+
+	// the tokens are lexed before the clock starts, only the parser is timed
+	Context context(input_path.c_str());
+	uint64_t best = UINT64_MAX;
+	for (size_t run = 0; run < BENCH_RUNS && context.errors.empty(); ++run)
+	{
+		context.Reset(input_path.c_str());
+		context.Lex();
+		auto start = get_time();
+		Parser(&context).Parse();
+		best = std::min(best, get_time_diff_ns(start));
+	}
+
+	std::error_code error;
+	std::filesystem::remove(input_path, error);
+	if (!context.errors.empty())
+	{
+		context.PrintMessages();
+		return false;
+	}
+	std::cout << "Parser: " << best / 1000 << "us (" << operand_count << " operands, " << context.tokens.Count()
+		<< " tokens)" << std::endl;
+	return true;
+}
+
+std::string Bench::GenerateExpression(size_t operand_count)
+{
+	const char operators[] = { '+', '-', '*', '/' };
+	std::string text = "fn main() i32\n{\n\treturn 1";
+	for (size_t i = 1; i < operand_count; ++i)
+	{
+		text += ' ';
+		text += operators[i % std::size(operators)];
+		text += ' ';
+		text += std::to_string(i % 9 + 1);
+	}
+	text += ";\n}\n";
+	return text;
+}
+
+std::string Bench::WriteInput(const char* name, const std::string& text)
+{
+	auto path = (std::filesystem::temp_directory_path() / name).string();
+	std::ofstream file(path, std::ios::binary);
+	file << text;
+	if (!file)
+	{
+		std::cout << "Error: could not write " << path << std::endl;
+		return std::string();
+	}
+	return path;
+}
+
+std::string Bench::GenerateProgram(size_t function_count)
+{
+	std::string text = "struct Point\n{\n\tx f32,\n\ty f32,\n}\n\nextern fn sqrt(x f32) f32;\n\n";
+	text += "fn calc0(a f32, b f32) f32\n{\n\treturn 1.5;\n}\n\n";
+	for (size_t i = 1; i < function_count; ++i)
+	{
+		auto name = std::to_string(i);
+		auto previous = std::to_string(i - 1);
+		text += "// function number " + name + " computes something\n";
+		text += "fn calc" + name + "(a f32, b f32) f32\n{\n";
+		text += "\tlet p Point;\n";
+		text += "\tp.x = sqrt(p.y);\n";
+		text += "\tlet d f32 = calc" + previous + "(p.x, p.y);\n";
+		text += "\treturn (p.x - p.y) * (p.y - p.x) + calc" + previous + "(p.y, p.x) / sqrt(p.x);\n";
+		text += "}\n\n";
+	}
+	return text;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Timings of the hot paths on inputs big enough to measure, see `jc --bench`. Generated
+// inputs are the same every run, so the numbers of two builds can be compared.
+class Bench
+{
+public:
+	// `args` are what follows --bench: "lexer [file]" or "parser [operands]"
+	explicit Bench(std::vector<const char*> args);
+
+	// false when no benchmark has that name or its input could not be read
+	bool Run();
+
+	// a main returning one expression of `operand_count` operands joined by + - * / in turn
+	static std::string GenerateExpression(size_t operand_count);
+	// `text` in a file of the temporary directory, empty when it could not be written
+	static std::string WriteInput(const char* name, const std::string& text);
+
+private:
+	// every kernel set this build and CPU have, on 64MB of indentation, long identifiers
+	// and comments
+	void BenchLexerKernels();
+	// Lexer::Lex and a whole compile of `path`, a generated program of about 43MB without one
+	bool BenchLexer(const char* path);
+	// Parser::Parse of one long expression, the depth of its tree is that of its operands
+	bool BenchParser(size_t operand_count);
+
+	// `function_count` functions that declare, assign, call and compute like real ones do
+	static std::string GenerateProgram(size_t function_count);
+
+	std::vector<const char*> args;
+};
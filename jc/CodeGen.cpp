@@ -1,5 +1,8 @@
 #include "CodeGen.hpp"
+#include "Parser.hpp"
 #include <cassert>
+#include <algorithm>
+#include <filesystem>
 
 const char* BinaryOperatorToCPPString(BinaryOperatorType op)
 {
@@ -11,6 +14,7 @@ const char* BinaryOperatorToCPPString(BinaryOperatorType op)
 	case BinaryOperatorType::Divide: return "/";
 	case BinaryOperatorType::Modulo: return "%";
 	case BinaryOperatorType::Equal: return "==";
+	case BinaryOperatorType::EqualEqual: return "==";
 	case BinaryOperatorType::NotEqual: return "!=";
 	case BinaryOperatorType::LessThan: return "<";
 	case BinaryOperatorType::LessThanEqual: return "<=";
@@ -23,244 +27,336 @@ const char* BinaryOperatorToCPPString(BinaryOperatorType op)
 	return "";
 }
 
-CodeGen::CodeGen(Context* context)
-	: context(context)
+const char* UnaryOperatorToCPPString(UnaryOperatorType op)
 {
+	switch (op)
+	{
+	case UnaryOperatorType::Plus: return "+";
+	case UnaryOperatorType::Minus: return "-";
+	case UnaryOperatorType::Not: return "!";
+	}
+
+	return "";
 }
 
-void CodeGen::Generate(std::ostream& out)
+CodeGen::CodeGen(Context* context)
+	: ASTVisitor(context)
 {
-	Output(out, context->program);
 }
 
-void CodeGen::Output(std::ostream& out, IfStatement* if_statement)
+void CodeGen::Generate(OutputBuffer& out)
 {
-	out << "if (";
-	Output(out, if_statement->condition);
-	out << ")";
-	Output(out, if_statement->if_body);
-	if (if_statement->else_body)
+	GenerateIncludes(out);
+
+	auto program = context->program;
+	auto& pool = context->GetThreadPool();
+	auto item_count = program->statements.size() + program->functions.size();
+	if (pool.ThreadCount() == 1 || context->lazy_bodies || item_count < MIN_PARALLEL_FUNCTIONS)
+	{
+		this->out = &out;
+		Walk(program);
+		return;
+	}
+
+	// the program is written statements first, then functions, and no item's text depends
+	// on another's, so workers write whole items into buffers that are spliced in order.
+	// Going batch by batch keeps only one batch of text in memory at a time
+	auto item = [&](size_t index) -> ASTNode*
+	{
+		if (index < program->statements.size())
+			return program->statements[index];
+		return program->functions[index - program->statements.size()];
+	};
+
+	// where in its worker's buffer the text of an item ended up
+	struct ItemText
 	{
-		out << "else";
-		Output(out, if_statement->else_body);
+		size_t worker;
+		size_t begin;
+		size_t end;
+	};
+
+	std::vector<CodeGen> generators;
+	std::vector<OutputBuffer> buffers;
+	generators.reserve(pool.ThreadCount());
+	buffers.reserve(pool.ThreadCount());
+	for (size_t i = 0; i < pool.ThreadCount(); ++i)
+	{
+		generators.emplace_back(context);
+		buffers.emplace_back();
+		generators.back().out = &buffers.back();
+	}
+
+	std::vector<ItemText> texts(std::min(item_count, CODEGEN_BATCH_ITEMS));
+	for (size_t batch_begin = 0; batch_begin < item_count; batch_begin += CODEGEN_BATCH_ITEMS)
+	{
+		auto batch_count = std::min(item_count - batch_begin, CODEGEN_BATCH_ITEMS);
+		pool.ParallelForStealing(batch_count, [&](size_t worker, size_t index)
+		{
+			auto begin = buffers[worker].Size();
+			generators[worker].Walk(item(batch_begin + index));
+			texts[index] = ItemText{ worker, begin, buffers[worker].Size() };
+		});
+
+		for (size_t i = 0; i < batch_count; ++i)
+		{
+			out.AppendRange(buffers[texts[i].worker], texts[i].begin, texts[i].end);
+		}
+		for (auto& buffer : buffers)
+		{
+			buffer.Clear();
+		}
 	}
 }
 
-void CodeGen::Output(std::ostream& out, CppBlock* cpp_block)
+void CodeGen::Generate(OutputBuffer& out, ASTNode* item)
 {
-	out << cpp_block->code;
+	this->out = &out;
+	Walk(item);
 }
 
-void CodeGen::Output(std::ostream& out, BlockNode* block)
+void CodeGen::GenerateDeclarations(OutputBuffer& out)
 {
-	out << "\n{\n";
-	for (auto statement : block->statements)
+	for (auto function : context->program->functions)
 	{
-		out << "\t";
-		Output(out, statement);
+		Output(out, function->prototype);
+		out << ";\n";
 	}
-	out << "}\n";
 }
 
-void CodeGen::Output(std::ostream& out, StringLiteral* string_literal)
+void CodeGen::GenerateHeader(OutputBuffer& out)
 {
-	out << "\"" << string_literal->value << "\"";
+	out << "#pragma once\n";
+	GenerateIncludes(out);
+
+	this->out = &out;
+	for (auto statement : context->program->statements)
+	{
+		if (statement->node_type == ASTNodeType::StructDefinationStatement)
+		{
+			Walk(statement);
+		}
+	}
+	GenerateDeclarations(out);
 }
 
-void CodeGen::Output(std::ostream& out, DeclarationStatement* declaration)
+void CodeGen::GenerateIncludes(OutputBuffer& out)
 {
-	out << declaration->data_type.name << " " << declaration->name;
-	if (declaration->expression)
+	for (const auto& path : context->import_paths)
 	{
-		out << " = ";
-		Output(out, declaration->expression);
+		out << "#include \"" << std::filesystem::path(path).replace_extension(".hpp").generic_string() << "\"\n";
 	}
-	out << ";\n";
 }
 
-void CodeGen::Output(std::ostream& out, AssignmentStatement* assigment)
+void CodeGen::Output(OutputBuffer& out, FunctionPrototype* prototype)
 {
-	Output(out, assigment->lhs);
-	out << " = ";
-	Output(out, assigment->rhs);
+	out << context->types.Name(prototype->return_type) << " " << prototype->name << "(";
+	for (int i = 0; i < prototype->params.size(); ++i)
+	{
+		auto& argument = prototype->params[i];
+		out << context->types.Name(argument.data_type) << " " << argument.name;
+		if (i < prototype->params.size() - 1)
+		{
+			out << ", ";
+		}
+	}
+	out << ")";
 }
 
-void CodeGen::Output(std::ostream& out, AssignmentExpression* expression)
+void CodeGen::Enter(Function* function)
 {
-	Output(out, expression->lhs);
-	out << " = ";
-	Output(out, expression->rhs);
+	Output(*out, function->prototype);
 }
 
+void CodeGen::Enter(BlockNode* block)
+{
+	*out << "\n{\n";
+}
 
-void CodeGen::Output(std::ostream& out, ForStatement* for_statement)
+void CodeGen::BeforeChild(BlockNode* block, size_t index)
 {
-	out << "for (";
-	if (for_statement->intialization)
-		Output(out, for_statement->intialization);
-	out << "; ";
-	if (for_statement->condition)
-		Output(out, for_statement->condition);
-	out << "; ";
-	if (for_statement->inc)
-		Output(out, for_statement->inc);
-	out << ")";
+	*out << "\t";
+}
 
-	Output(out, for_statement->body);
+void CodeGen::Leave(BlockNode* block)
+{
+	*out << "}\n";
+}
 
+void CodeGen::Leave(ExpressionStatement* statement)
+{
+	*out << ";\n";
 }
 
+void CodeGen::Enter(ReturnStatement* statement)
+{
+	*out << "return ";
+}
 
-void CodeGen::Output(std::ostream& out, FunctionPrototype* prototype)
+void CodeGen::Leave(ReturnStatement* statement)
 {
-	out << prototype->return_type.name << " " << prototype->name << "(";
-	for (int i = 0; i < prototype->params.size(); ++i)
+	*out << ";\n";
+}
+
+void CodeGen::Enter(CallStatement* statement)
+{
+	*out << statement->name << "(";
+}
+
+void CodeGen::BeforeChild(CallStatement* statement, size_t index)
+{
+	if (index > 0)
 	{
-		auto& argument = prototype->params[i];
-		out << argument.data_type.name << " " << argument.name;
-		if (i < prototype->params.size() - 1)
-		{
-			out << ", ";
-		}
+		*out << ", ";
 	}
-	out << ")";
 }
 
-void CodeGen::Output(std::ostream& out, CallExpression* call)
+void CodeGen::Leave(CallStatement* statement)
+{
+	*out << ");\n";
+}
+
+void CodeGen::Enter(ForStatement* for_statement)
 {
-	out << call->name << "(";
-	for (int i = 0; i < call->args.size(); ++i)
+	*out << "for (";
+}
+
+void CodeGen::BeforeChild(ForStatement* for_statement, size_t index)
+{
+	// intialization; condition; inc) body
+	switch (index)
 	{
-		auto argument_expression = call->args[i];
-		Output(out, argument_expression);
-		if (i < call->args.size() - 1)
-		{
-			out << ", ";
-		}
+	case 1:
+	case 2: *out << "; "; break;
+	case 3: *out << ")"; break;
 	}
-	out << ")";
 }
 
-void CodeGen::Output(std::ostream& out, Variable* variable)
+void CodeGen::Enter(IfStatement* if_statement)
 {
-	out << variable->name;
+	*out << "if (";
 }
 
-void CodeGen::Output(std::ostream& out, NumberLiteral* number)
+void CodeGen::BeforeChild(IfStatement* if_statement, size_t index)
 {
-	out << number->value;
+	// condition) if_body else else_body
+	if (index == 1)
+	{
+		*out << ")";
+	}
+	else if (index == 2 && if_statement->else_body)
+	{
+		*out << "else";
+	}
 }
 
-void CodeGen::Output(std::ostream& out, BinaryExpression* expression)
+void CodeGen::BeforeChild(AssignmentStatement* assigment, size_t index)
 {
-	out << "(";
-	Output(out, expression->lhs);
-	out << " " << BinaryOperatorToCPPString(expression->op) << " ";
-	Output(out, expression->rhs);
-	out << ")";
+	if (index == 1)
+	{
+		*out << " = ";
+	}
 }
 
-void CodeGen::Output(std::ostream& out, Expression* expression)
+void CodeGen::Enter(DeclarationStatement* declaration)
 {
-	switch (expression->node_type)
+	*out << context->types.Name(declaration->data_type) << " " << declaration->name;
+	if (declaration->expression)
 	{
-	case ASTNodeType::CallExpression: Output(out, static_cast<CallExpression*>(expression)); break;
-	case ASTNodeType::BinaryExpression: Output(out, static_cast<BinaryExpression*>(expression)); break;
-	case ASTNodeType::Variable: Output(out, static_cast<Variable*>(expression)); break;
-	case ASTNodeType::NumberLiteral: Output(out, static_cast<NumberLiteral*>(expression)); break;
-	case ASTNodeType::StringLiteral: Output(out, static_cast<StringLiteral*>(expression)); break;
-	case ASTNodeType::AssignmentExpression: Output(out, static_cast<AssignmentExpression*>(expression)); break;
-	case ASTNodeType::Argument: Output(out, static_cast<Argument*>(expression)->expression); break;
-	case ASTNodeType::MemberAccessExpression: Output(out, static_cast<MemberAccessExpression*>(expression)); break;
-	default:
-		assert(false);
-		break;
+		*out << " = ";
 	}
 }
 
-void CodeGen::Output(std::ostream& out, ExpressionStatement* statement)
+void CodeGen::Leave(DeclarationStatement* declaration)
 {
-	Output(out, statement->expression);
-	out << ";\n";
+	*out << ";\n";
 }
 
-void CodeGen::Output(std::ostream& out, ReturnStatement* statement)
+void CodeGen::Enter(CppBlock* cpp_block)
 {
-	out << "return ";
-	Output(out, statement->expression);
-	out << ";\n";
+	*out << cpp_block->code;
 }
 
-void CodeGen::Output(std::ostream& out, CallStatement* statement)
+void CodeGen::Enter(StructDefinationStatement* struct_defination)
 {
-	out << statement->name << "(";
-	for (int i = 0; i < statement->args.size(); ++i)
+	*out << "struct " << struct_defination->defination->name << "\n{\n";
+	for (const auto& field : struct_defination->defination->fields)
 	{
-		auto argument_expression = statement->args[i];
-		Output(out, argument_expression);
-		if (i < statement->args.size() - 1)
-		{
-			out << ", ";
-		}
+		*out << "\t" << context->types.Name(field.data_type) << " " << field.name << ";\n";
 	}
-	out << ");\n";
+	*out << "};\n";
+}
+
+void CodeGen::Enter(CallExpression* call)
+{
+	*out << call->name << "(";
 }
 
-void CodeGen::Output(std::ostream& out, Statement* statement)
+void CodeGen::BeforeChild(CallExpression* call, size_t index)
 {
-	switch (statement->node_type)
+	if (index > 0)
 	{
-	case ASTNodeType::ExpressionStatement: Output(out, static_cast<ExpressionStatement*>(statement)); break;
-	case ASTNodeType::ReturnStatement: Output(out, static_cast<ReturnStatement*>(statement)); break;
-	case ASTNodeType::CallStatement: Output(out, static_cast<CallStatement*>(statement)); break;
-	case ASTNodeType::AssignmentStatement: Output(out, static_cast<AssignmentStatement*>(statement)); break;
-	case ASTNodeType::ForStatement: Output(out, static_cast<ForStatement*>(statement)); break;
-	case ASTNodeType::IfStatement: Output(out, static_cast<IfStatement*>(statement)); break;
-	case ASTNodeType::DeclarationStatement: Output(out, static_cast<DeclarationStatement*>(statement)); break;
-	case ASTNodeType::BlockNode: Output(out, static_cast<BlockNode*>(statement)); break;
-	case ASTNodeType::CppBlock: Output(out, static_cast<CppBlock*>(statement)); break;
-	case ASTNodeType::StructDefinationStatement: Output(out, static_cast<StructDefinationStatement*>(statement)); break;
-
-	case ASTNodeType::ExternFunctionStatement:
-	case ASTNodeType::ExternVariableStatement:
-		// no output
-		break;
-	default: assert(false); break;
+		*out << ", ";
 	}
 }
 
-void CodeGen::Output(std::ostream& out, Function* function)
+void CodeGen::Leave(CallExpression* call)
 {
-	Output(out, function->prototype);
-	Output(out, function->body);
+	*out << ")";
 }
 
-void CodeGen::Output(std::ostream& out, Program* program)
+void CodeGen::Enter(Variable* variable)
 {
-	
-	for (auto statement : program->statements)
-	{
-		Output(out, statement);
-	}
+	*out << variable->name;
+}
 
-	for (auto function : program->functions)
+void CodeGen::Enter(NumberLiteral* number)
+{
+	*out << number->value;
+}
+
+void CodeGen::Enter(StringLiteral* string_literal)
+{
+	*out << "\"" << string_literal->value << "\"";
+}
+
+void CodeGen::Enter(BinaryExpression* expression)
+{
+	*out << "(";
+}
+
+void CodeGen::BeforeChild(BinaryExpression* expression, size_t index)
+{
+	if (index == 1)
 	{
-		Output(out, function);
+		*out << " " << BinaryOperatorToCPPString(expression->op) << " ";
 	}
 }
 
-void CodeGen::Output(std::ostream& out, StructDefinationStatement* struct_defination)
+void CodeGen::Leave(BinaryExpression* expression)
 {
-	out << "struct " << struct_defination->defination->name << "\n{\n";
-	for (const auto& field : struct_defination->defination->fields)
+	*out << ")";
+}
+
+void CodeGen::Enter(UnaryExpression* expression)
+{
+	*out << "(" << UnaryOperatorToCPPString(expression->op);
+}
+
+void CodeGen::Leave(UnaryExpression* expression)
+{
+	*out << ")";
+}
+
+void CodeGen::BeforeChild(AssignmentExpression* expression, size_t index)
+{
+	if (index == 1)
 	{
-		out << "\t" << field.data_type.name << " " << field.name << ";\n";
+		*out << " = ";
 	}
-	out << "};\n";
 }
 
-void CodeGen::Output(std::ostream& out, MemberAccessExpression* member_access)
+void CodeGen::Leave(MemberAccessExpression* member_access)
 {
-	Output(out, member_access->lhs);
-	out << "." << member_access->member;
+	*out << "." << member_access->member;
 }
@@ -1,36 +1,68 @@
 #pragma once
 #include "Context.hpp"
+#include "ASTVisitor.hpp"
+#include "OutputBuffer.hpp"
 
-class CodeGen
+// how many top level items are generated in parallel before their text is written out
+constexpr size_t CODEGEN_BATCH_ITEMS = 4096;
+
+// The C++ of a program. A compile cache keeps the text of each function from the build
+// that wrote it, so any change to that text has to bump COMPILE_CACHE_VERSION
+class CodeGen : public ASTVisitor<CodeGen>
 {
 public:
 	explicit CodeGen(Context* context);
 
-	void Generate(std::ostream& out);
+	void Generate(OutputBuffer& out);
+	// the text of a single top level statement or function
+	void Generate(OutputBuffer& out, ASTNode* item);
+	// one forward declaration per function, only looks at the prototypes
+	void GenerateDeclarations(OutputBuffer& out);
+	// what modules importing this one need, its structs and the declarations of its functions
+	void GenerateHeader(OutputBuffer& out);
+	// includes the header of every imported module
+	void GenerateIncludes(OutputBuffer& out);
 
 private:
-	void Output(std::ostream& out, Program* program);
-	void Output(std::ostream& out, Statement* statement);
-	void Output(std::ostream& out, Function* function);
-	void Output(std::ostream& out, Expression* expression);
-	void Output(std::ostream& out, FunctionPrototype* prototype);
-	void Output(std::ostream& out, CallExpression* call);
-	void Output(std::ostream& out, Variable* variable);
-	void Output(std::ostream& out, NumberLiteral* number);
-	void Output(std::ostream& out, StringLiteral* string_literal);
-	void Output(std::ostream& out, BinaryExpression* expression);
-	void Output(std::ostream& out, ExpressionStatement* statement);
-	void Output(std::ostream& out, ReturnStatement* statement);
-	void Output(std::ostream& out, CallStatement* statement);
-	void Output(std::ostream& out, ForStatement* for_statement);
-	void Output(std::ostream& out, AssignmentStatement* assigment);
-	void Output(std::ostream& out, AssignmentExpression* expression);
-	void Output(std::ostream& out, DeclarationStatement* declaration);
-	void Output(std::ostream& out, BlockNode* block);
-	void Output(std::ostream& out, IfStatement* if_statement);
-	void Output(std::ostream& out, CppBlock* cpp_block);
-	void Output(std::ostream& out, StructDefinationStatement* struct_defination);
-	void Output(std::ostream& out, MemberAccessExpression* member_access);
+	friend class ASTVisitor<CodeGen>;
+
+	void Output(OutputBuffer& out, FunctionPrototype* prototype);
+
+	// the text of a node is split around its children, Enter writes what comes before
+	// them, BeforeChild the separators and Leave what comes after
+	void Enter(Function* function);
+	void Enter(BlockNode* block);
+	void BeforeChild(BlockNode* block, size_t index);
+	void Leave(BlockNode* block);
+	void Leave(ExpressionStatement* statement);
+	void Enter(ReturnStatement* statement);
+	void Leave(ReturnStatement* statement);
+	void Enter(CallStatement* statement);
+	void BeforeChild(CallStatement* statement, size_t index);
+	void Leave(CallStatement* statement);
+	void Enter(ForStatement* for_statement);
+	void BeforeChild(ForStatement* for_statement, size_t index);
+	void Enter(IfStatement* if_statement);
+	void BeforeChild(IfStatement* if_statement, size_t index);
+	void BeforeChild(AssignmentStatement* assigment, size_t index);
+	void Enter(DeclarationStatement* declaration);
+	void Leave(DeclarationStatement* declaration);
+	void Enter(CppBlock* cpp_block);
+	void Enter(StructDefinationStatement* struct_defination);
+	void Enter(CallExpression* call);
+	void BeforeChild(CallExpression* call, size_t index);
+	void Leave(CallExpression* call);
+	void Enter(Variable* variable);
+	void Enter(NumberLiteral* number);
+	void Enter(StringLiteral* string_literal);
+	void Enter(BinaryExpression* expression);
+	void BeforeChild(BinaryExpression* expression, size_t index);
+	void Leave(BinaryExpression* expression);
+	void Enter(UnaryExpression* expression);
+	void Leave(UnaryExpression* expression);
+	void BeforeChild(AssignmentExpression* expression, size_t index);
+	void Leave(MemberAccessExpression* member_access);
 
-	Context* context;
-};
\ No newline at end of file
+	// where Generate is writing to
+	OutputBuffer* out = nullptr;
+};
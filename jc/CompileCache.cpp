@@ -0,0 +1,495 @@
+#include "CompileCache.hpp"
+#include "Scope.hpp"
+#include "Parser.hpp"
+#include "TypeGenerator.hpp"
+#include "TypeChecker.hpp"
+#include "CodeGen.hpp"
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+
+// bumped whenever the layout of the file changes, a file of another layout is ignored
+constexpr char CACHE_MAGIC[8] = { 'j', 'c', 'c', 'a', 'c', 'h', 'e', '2' };
+
+constexpr uint64_t HASH_SEED = 0x6a09e667f3bcc908ull;
+
+constexpr uint64_t HASH_M = 0xc6a4a7935bd1e995ull;
+constexpr int HASH_R = 47;
+
+static uint64_t Hash(uint64_t hash, std::string_view bytes)
+{
+	// MurmurHash64A, eight bytes per step since every function's whole text goes through
+	// here. Keys are never compared with their text, so they have to be wide and well mixed
+	constexpr uint64_t M = HASH_M;
+	constexpr int R = HASH_R;
+	hash ^= bytes.size() * M;
+
+	size_t i = 0;
+	for (; i + 8 <= bytes.size(); i += 8)
+	{
+		uint64_t k;
+		std::memcpy(&k, bytes.data() + i, 8);
+		k *= M;
+		k ^= k >> R;
+		k *= M;
+		hash ^= k;
+		hash *= M;
+	}
+
+	if (i < bytes.size())
+	{
+		uint64_t k = 0;
+		std::memcpy(&k, bytes.data() + i, bytes.size() - i);
+		hash ^= k;
+		hash *= M;
+	}
+
+	hash ^= hash >> R;
+	hash *= M;
+	hash ^= hash >> R;
+	return hash;
+}
+
+// one step of the loop above, for hashes that are mixed together
+static uint64_t Hash(uint64_t hash, uint64_t value)
+{
+	value *= HASH_M;
+	value ^= value >> HASH_R;
+	value *= HASH_M;
+	hash ^= value;
+	return hash * HASH_M;
+}
+
+template<typename T>
+static void Write(OutputBuffer& out, T value)
+{
+	out.Append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void Write(OutputBuffer& out, const std::vector<Message>& messages)
+{
+	Write(out, (uint32_t)messages.size());
+	for (auto& message : messages)
+	{
+		Write(out, (uint32_t)message.line);
+		Write(out, (uint32_t)message.column);
+		Write(out, (uint32_t)message.text.size());
+		out << message.text;
+	}
+}
+
+// reads what Write wrote, every read fails once one runs past the end
+struct CacheReader
+{
+	std::string_view data;
+	size_t offset = 0;
+
+	template<typename T>
+	bool Read(T& value)
+	{
+		if (data.size() - offset < sizeof(T))
+			return false;
+		std::memcpy(&value, data.data() + offset, sizeof(T));
+		offset += sizeof(T);
+		return true;
+	}
+
+	bool Read(std::string_view& text, size_t size)
+	{
+		if (data.size() - offset < size)
+			return false;
+		text = data.substr(offset, size);
+		offset += size;
+		return true;
+	}
+
+	bool Read(std::vector<Message>& messages)
+	{
+		uint32_t count;
+		if (!Read(count))
+			return false;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t line, column, size;
+			std::string_view text;
+			if (!Read(line) || !Read(column) || !Read(size) || !Read(text, size))
+				return false;
+			messages.push_back(Message{ std::string(text), line, column });
+		}
+		return true;
+	}
+};
+
+CompileCache::CompileCache(Context* context, const char* directory)
+	: context(context)
+{
+	// one file per source, named after where the source is so every copy of it has its own
+	std::error_code error;
+	auto source_path = std::filesystem::weakly_canonical(context->file_path, error);
+	if (error)
+	{
+		source_path = std::filesystem::absolute(context->file_path, error);
+	}
+	auto name = Hash(HASH_SEED, source_path.string());
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)name);
+	std::filesystem::create_directories(directory, error);
+	path = (std::filesystem::path(directory) / (std::string(hex) + ".jcc")).string();
+
+	declaration_hashes.resize(context->symbols.Count());
+	declaration_hashed.resize(context->symbols.Count());
+	for (auto variable : context->root_scope->variables)
+	{
+		globals[variable->symbol].push_back(variable);
+	}
+
+	Load();
+}
+
+void CompileCache::Load()
+{
+	if (!file.Open(path.c_str()))
+	{
+		return;
+	}
+
+	if (!Read(file.View()))
+	{
+		// a damaged or older file counts as empty, the next Save replaces it
+		entries.clear();
+	}
+}
+
+bool CompileCache::Read(std::string_view data)
+{
+	CacheReader reader{ data };
+	std::string_view magic;
+	uint32_t version;
+	uint64_t count;
+	if (!reader.Read(magic, sizeof(CACHE_MAGIC)) || magic != std::string_view(CACHE_MAGIC, sizeof(CACHE_MAGIC)) ||
+		!reader.Read(version) || version != COMPILE_CACHE_VERSION || !reader.Read(count))
+	{
+		return false;
+	}
+
+	entries.reserve(count);
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		uint64_t key;
+		Entry entry;
+		uint8_t generated;
+		if (!reader.Read(key) || !reader.Read(entry.errors) || !reader.Read(entry.warnings) || !reader.Read(generated))
+		{
+			return false;
+		}
+
+		entry.generated = generated != 0;
+		if (entry.generated)
+		{
+			uint64_t size;
+			if (!reader.Read(size) || !reader.Read(entry.text, size))
+			{
+				return false;
+			}
+		}
+		entries.emplace(key, std::move(entry));
+	}
+	return true;
+}
+
+void CompileCache::Check()
+{
+	auto& functions = context->program->functions;
+	auto& tokens = context->tokens;
+	results.resize(functions.size());
+	std::vector<size_t> misses;
+	for (size_t i = 0; i < functions.size(); ++i)
+	{
+		auto function = functions[i];
+		auto& result = results[i];
+		result.key = Key(function);
+		result.first_line = tokens.Line(function->begin);
+		result.last_line = tokens.Line(function->body_end - 1);
+
+		// an entry without text is only good for a program that is not generated, one with errors
+		auto found = entries.find(result.key);
+		if (found != entries.end() && (found->second.generated || !found->second.errors.empty()))
+		{
+			result.cached = &found->second;
+			used += !result.cached->used;
+			result.cached->used = true;
+			reused++;
+		}
+		else
+		{
+			misses.push_back(i);
+		}
+	}
+
+	// a body that does not parse stops the compile before checking, the same as without a cache
+	auto first_error = context->errors.size();
+	for (auto index : misses)
+	{
+		context->GetFunctionBody(functions[index]);
+	}
+	if (context->errors.size() != first_error)
+	{
+		return;
+	}
+
+	auto& pool = context->GetThreadPool();
+	if (pool.ThreadCount() > 1 && misses.size() >= MIN_PARALLEL_FUNCTIONS)
+	{
+		std::vector<FusedPass<TypeGenertaor, TypeChecker>> semantics;
+		semantics.reserve(pool.ThreadCount());
+		for (size_t i = 0; i < pool.ThreadCount(); ++i)
+		{
+			semantics.emplace_back(context);
+		}
+
+		pool.ParallelForStealing(misses.size(), [&](size_t worker, size_t index)
+		{
+			auto& result = results[misses[index]];
+			semantics[worker].SetDiagnostics(&result.errors, &result.warnings);
+			semantics[worker].Walk(functions[misses[index]]);
+		});
+	}
+	else
+	{
+		FusedPass<TypeGenertaor, TypeChecker> semantics(context);
+		for (auto index : misses)
+		{
+			semantics.SetDiagnostics(&results[index].errors, &results[index].warnings);
+			semantics.Walk(functions[index]);
+		}
+	}
+
+	for (auto& result : results)
+	{
+		if (result.cached)
+		{
+			Relocate(result.cached->errors, context->errors, result.first_line);
+			Relocate(result.cached->warnings, context->warnings, result.first_line);
+		}
+		else
+		{
+			context->errors.insert(context->errors.end(), result.errors.begin(), result.errors.end());
+			context->warnings.insert(context->warnings.end(), result.warnings.begin(), result.warnings.end());
+		}
+	}
+}
+
+void CompileCache::Generate(OutputBuffer& out)
+{
+	CodeGen codegen(context);
+	codegen.GenerateIncludes(out);
+	for (auto statement : context->program->statements)
+	{
+		codegen.Generate(out, statement);
+	}
+
+	auto& functions = context->program->functions;
+	for (size_t i = 0; i < functions.size(); ++i)
+	{
+		auto& result = results[i];
+		if (result.cached)
+		{
+			out << result.cached->text;
+			continue;
+		}
+
+		result.text_begin = generated.Size();
+		codegen.Generate(generated, functions[i]);
+		result.text_end = generated.Size();
+		result.has_text = true;
+		out.AppendRange(generated, result.text_begin, result.text_end);
+	}
+}
+
+void CompileCache::Save()
+{
+	// nothing new and nothing unused, the file stays as it is
+	if (reused == results.size() && used == entries.size())
+	{
+		return;
+	}
+
+	// a function that is in the file twice is written once, one that was cached has an
+	// entry to mark, two that missed can only be told apart by their key
+	std::unordered_set<uint64_t> written;
+	std::vector<Result*> kept;
+	for (auto& result : results)
+	{
+		if (result.cached)
+		{
+			if (result.cached->used)
+			{
+				result.cached->used = false;
+				kept.push_back(&result);
+			}
+			continue;
+		}
+
+		// a clean function is only worth keeping with its text
+		if (!MakeRelative(result.errors, result) || !MakeRelative(result.warnings, result) ||
+			(result.errors.empty() && !result.has_text) || !written.insert(result.key).second)
+		{
+			continue;
+		}
+		kept.push_back(&result);
+	}
+
+	OutputBuffer out;
+	out.Append(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	Write(out, COMPILE_CACHE_VERSION);
+	Write(out, (uint64_t)kept.size());
+	for (auto result : kept)
+	{
+		Write(out, result->key);
+		if (result->cached)
+		{
+			Write(out, result->cached->errors);
+			Write(out, result->cached->warnings);
+			Write(out, (uint8_t)result->cached->generated);
+			if (result->cached->generated)
+			{
+				Write(out, (uint64_t)result->cached->text.size());
+				out << result->cached->text;
+			}
+		}
+		else
+		{
+			Write(out, result->errors);
+			Write(out, result->warnings);
+			Write(out, (uint8_t)result->has_text);
+			if (result->has_text)
+			{
+				Write(out, (uint64_t)(result->text_end - result->text_begin));
+				out.AppendRange(generated, result->text_begin, result->text_end);
+			}
+		}
+	}
+
+	// the cached text was copied already. The new file is renamed over the old one, so a
+	// compile reading it at the same time sees either all of the old one or all of the new one
+	file.Close();
+	entries.clear();
+	if (!out.WriteToFile(path.c_str()))
+	{
+		context->Warning("Could not write the cache file " + path, 0, 0);
+	}
+}
+
+uint64_t CompileCache::Key(Function* function)
+{
+	// the text from "fn" to "}", the body parsed without errors so it ends in a brace.
+	// The column is part of it since the messages keep theirs
+	auto& tokens = context->tokens;
+	auto begin = tokens.Offset(function->begin);
+	auto end = tokens.Offset(function->body_end - 1) + 1;
+	auto hash = Hash(HASH_SEED, context->input.substr(begin, end - begin));
+	hash = Hash(hash, (uint64_t)tokens.Column(function->begin));
+	// warnings are only kept when they are printed, an entry from a compile without them has none
+	hash = Hash(hash, (uint64_t)context->print_warings);
+
+	for (auto i = function->begin; i < function->body_end; ++i)
+	{
+		auto symbol = tokens.Symbol(i);
+		if (symbol != INVALID_SYMBOL)
+		{
+			hash = Hash(hash, DeclarationHash(symbol));
+		}
+	}
+	return hash;
+}
+
+uint64_t CompileCache::DeclarationHash(SymbolId symbol)
+{
+	if (declaration_hashed[symbol])
+	{
+		return declaration_hashes[symbol];
+	}
+
+	// locals hash to 0, a name that starts to mean something at the top level changes the key
+	uint64_t hash = 0;
+	if (auto prototype = context->functions.Get(symbol))
+	{
+		hash = Hash(HASH_SEED, "fn");
+		hash = Hash(hash, TypeHash(prototype->return_type));
+		for (auto& param : prototype->params)
+		{
+			hash = Hash(hash, param.name);
+			hash = Hash(hash, TypeHash(param.data_type));
+		}
+	}
+
+	if (auto defination = context->structs.Get(symbol))
+	{
+		hash = Hash(Hash(hash, "struct"), StructHash(defination));
+	}
+
+	if (auto found = globals.find(symbol); found != globals.end())
+	{
+		for (auto variable : found->second)
+		{
+			hash = Hash(Hash(hash, "let"), TypeHash(variable->data_type));
+		}
+	}
+
+	declaration_hashes[symbol] = hash;
+	declaration_hashed[symbol] = true;
+	return hash;
+}
+
+uint64_t CompileCache::TypeHash(Type type)
+{
+	if (auto defination = context->GetStructByType(type))
+	{
+		return StructHash(defination);
+	}
+	return Hash(HASH_SEED, context->types.Name(type));
+}
+
+uint64_t CompileCache::StructHash(const StructDefination* defination)
+{
+	if (auto found = struct_hashes.find(defination); found != struct_hashes.end())
+	{
+		return found->second;
+	}
+
+	// a struct that contains itself sees its own name instead of looping
+	struct_hashes[defination] = Hash(HASH_SEED, defination->name);
+	auto hash = Hash(HASH_SEED, defination->name);
+	for (auto& field : defination->fields)
+	{
+		hash = Hash(hash, field.name);
+		hash = Hash(hash, TypeHash(field.data_type));
+	}
+	struct_hashes[defination] = hash;
+	return hash;
+}
+
+void CompileCache::Relocate(const std::vector<Message>& from, std::vector<Message>& to, size_t first_line)
+{
+	for (auto& message : from)
+	{
+		to.push_back(Message{ message.text, message.line == 0 ? 0 : message.line + first_line - 1, message.column });
+	}
+}
+
+bool CompileCache::MakeRelative(std::vector<Message>& messages, const Result& result)
+{
+	for (auto& message : messages)
+	{
+		if (message.line != 0 && (message.line < result.first_line || message.line > result.last_line))
+		{
+			return false;
+		}
+		if (message.line != 0)
+		{
+			message.line -= result.first_line - 1;
+		}
+	}
+	return true;
+}
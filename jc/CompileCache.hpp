@@ -0,0 +1,101 @@
+#pragma once
+#include "Context.hpp"
+#include "OutputBuffer.hpp"
+#include "SourceBuffer.hpp"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// What the checker reports and what CodeGen writes for a function. Any change to either,
+// or to the parser or the passes before them, has to bump it, a cache written by another
+// version is ignored as a whole. CodeGen, TypeGenertaor and TypeChecker point back here
+constexpr uint32_t COMPILE_CACHE_VERSION = 1;
+
+// Results of checking and generating each function, kept on disk between compiles so a
+// function that did not change is neither parsed past its signature, checked nor generated
+// again. A function is keyed by its source text and by every top level declaration it
+// names: functions by their prototype, structs by their fields, globals by their type,
+// and the structs any of those mention in turn. Editing a body only misses that function,
+// changing a signature misses everything that names it.
+// Every source file has one file in the cache directory, rewritten after each compile
+// with the entries it used. Structs, globals and other top level statements are checked
+// and generated every time, they are what the keys are made from and cost next to nothing.
+class CompileCache
+{
+public:
+	// the program has to be parsed with lazy_bodies, so only functions that miss get a body
+	CompileCache(Context* context, const char* directory);
+
+	// finds every function in the cache, parses the bodies of those that are not and
+	// checks them, the diagnostics of the others are reported as they were cached
+	void Check();
+	// the text of the whole program, the same as CodeGen::Generate
+	void Generate(OutputBuffer& out);
+	// writes back the entries of this compile, nothing if they are all cached already
+	void Save();
+
+	size_t FunctionCount() const { return results.size(); }
+	size_t ReusedCount() const { return reused; }
+
+private:
+	// lines are counted from the line the function starts on, so moving it keeps the entry
+	struct Entry
+	{
+		std::vector<Message> errors;
+		std::vector<Message> warnings;
+		// only when the whole program was generated, an entry with errors never has it
+		bool generated = false;
+		std::string_view text;
+		// a function of this compile has it, Save writes it once
+		bool used = false;
+	};
+
+	// what this compile has for one function
+	struct Result
+	{
+		uint64_t key = 0;
+		size_t first_line = 0;
+		size_t last_line = 0;
+		Entry* cached = nullptr;
+		// of a function checked now, absolute lines until Save
+		std::vector<Message> errors;
+		std::vector<Message> warnings;
+		// where its text is in `generated`, for a function generated now
+		bool has_text = false;
+		size_t text_begin = 0;
+		size_t text_end = 0;
+	};
+
+	void Load();
+	bool Read(std::string_view data);
+
+	uint64_t Key(Function* function);
+	uint64_t DeclarationHash(SymbolId symbol);
+	uint64_t TypeHash(Type type);
+	uint64_t StructHash(const StructDefination* defination);
+
+	// appends cached messages with their lines counted from the start of the file again
+	static void Relocate(const std::vector<Message>& from, std::vector<Message>& to, size_t first_line);
+	// the other way around in place, false when a message is outside the function
+	static bool MakeRelative(std::vector<Message>& messages, const Result& result);
+
+	Context* context;
+	std::string path;
+	// the cache file as it was before this compile, entries point into it
+	SourceBuffer file;
+	std::unordered_map<uint64_t, Entry> entries;
+	std::vector<Result> results;
+	size_t reused = 0;
+	// entries some function has, functions with the same text share one
+	size_t used = 0;
+	// the text of every function generated now, one after another
+	OutputBuffer generated;
+
+	// the hash of what each symbol names at the top level, 0 for nothing
+	std::vector<uint64_t> declaration_hashes;
+	std::vector<bool> declaration_hashed;
+	std::unordered_map<const StructDefination*, uint64_t> struct_hashes;
+	// globals by symbol, several when a name is declared twice
+	std::unordered_map<SymbolId, std::vector<Variable*>> globals;
+};
@@ -6,32 +6,124 @@
 #include "TypeGenerator.hpp"
 #include "TypeChecker.hpp"
 #include "CodeGen.hpp"
+#include "OutputBuffer.hpp"
+#include "Pipeline.hpp"
+#include "CompileCache.hpp"
+#include "ModuleInterface.hpp"
 #include <cassert>
+#include <algorithm>
+
+// stable, so messages at the same location keep the order they were reported in
+static void SortMessages(std::vector<Message>& messages, size_t first)
+{
+	std::stable_sort(messages.begin() + first, messages.end(), [](const Message& a, const Message& b)
+	{
+		return a.line != b.line ? a.line < b.line : a.column < b.column;
+	});
+}
 
 Context::Context(const char* file_path)
-	:program(nullptr)
+	: program(nullptr)
+{
+	Open(file_path);
+}
+
+Context::~Context() = default;
+
+void Context::Reset(const char* file_path)
+{
+	// the parser points into the arena, so it goes before the arena is rewound
+	body_parser.reset();
+	arena.Reset();
+	for (auto& worker_arena : worker_arenas)
+	{
+		worker_arena->Reset();
+	}
+
+	symbols.Clear();
+	structs.Clear();
+	types.Clear();
+	functions.Clear();
+	errors.clear();
+	warnings.clear();
+	tokens.Clear();
+	program = nullptr;
+	import_paths.clear();
+	imports.clear();
+	output_path = nullptr;
+	lexed = false;
+	source.Close();
+	Open(file_path);
+}
+
+void Context::Open(const char* file_path)
 {
-	input = read_file_into_string_view(file_path);
-	current_scope = new Scope(0, -1, this);
-	root_scope = current_scope;
-	scopes.push_back(current_scope);
+	this->file_path = file_path;
+	if (source.Open(file_path))
+	{
+		input = source.View();
+	}
+	else
+	{
+		// still lexes to a lone EndOfFile, the literal has the '\0' the lexer stops at
+		Error("Could not read " + std::string(file_path), 0, 0);
+		input = "";
+	}
+	root_scope = arena.New<Scope>(0, nullptr);
 }
 
 void Context::Compile()
 {
 	auto compile_start = get_time();
 
+	if (pipeline)
 	{
-		Lexer lexer(this);
-		auto lexer_start = get_time();
-		lexer.Lex();
-		auto lexer_time = get_time_diff_ms(lexer_start);
+		auto first_error = errors.size();
+		auto first_warning = warnings.size();
+		{
+			Pipeline pipeline(this);
+			pipeline.Run();
+		}
+		SortMessages(errors, first_error);
+		SortMessages(warnings, first_warning);
+
+		auto compile_time = get_time_diff_ms(compile_start);
 		if (print_timing)
-			std::cout << "Lexer Took: " << lexer_time << "ms" << std::endl;
+			std::cout << "Pipeline Took: " << compile_time << "ms (" << GetThreadPool().ThreadCount() << " threads)" << std::endl;
+		return;
+	}
+
+	if (!stream_tokens && !lexed)
+	{
+		Lex();
+	}
+
+	// only the bodies the cache misses are parsed, the others are skimmed over
+	bool incremental = cache_path && !stream_tokens && !signatures_only;
+	bool lazy = lazy_bodies;
+	if (incremental)
+	{
+		lazy_bodies = true;
 	}
 
-	if(errors.empty())
+	if (stream_tokens)
 	{
+		// the parser pulls tokens from the lexer as it goes, so only a small window
+		// of tokens is ever alive and lex errors are reported together with parse errors
+		Lexer lexer(this);
+		auto parser_start = get_time();
+		if (lexer.Begin())
+		{
+			Parser parser(this, &lexer);
+			parser.Parse();
+		}
+		auto parser_time = get_time_diff_ms(parser_start);
+		if (print_timing)
+			std::cout << "Lexer + Parser Took: " << parser_time << "ms (streaming)" << std::endl;
+	}
+	else if(errors.empty())
+	{
+		ImportDeclarations();
 		Parser parser(this);
 		auto parser_start = get_time();
 		parser.Parse();
@@ -44,39 +136,141 @@ void Context::Compile()
 		std::cout << "Not Parsing because of previous errors" << std::endl;
 	}
 
-	if (errors.empty())
+	std::unique_ptr<CompileCache> cache;
+	if (incremental)
 	{
-		TypeGenertaor generator(this);
-		auto typegen_start = get_time();
-		generator.Generate();
-		auto typegen_time = get_time_diff_ms(typegen_start);
-		if (print_timing)
-			std::cout << "TypeGenertaor Took: " << typegen_time << "ms" << std::endl;
+		lazy_bodies = lazy;
+		if (errors.empty())
+		{
+			cache = std::make_unique<CompileCache>(this, cache_path);
+		}
+		else if (program && !lazy)
+		{
+			// the bodies still get their parse errors reported
+			for (auto function : program->functions)
+			{
+				GetFunctionBody(function);
+			}
+		}
 	}
-	else
+
+	if (signatures_only && errors.empty())
 	{
-		std::cout << "Not Type Generating because of previous errors" << std::endl;
+		// a query that only needs the declarations, bodies stay unparsed token ranges
+		CodeGen codegen(this);
+		auto output = OpenOutput();
+		codegen.GenerateDeclarations(output);
+		CloseOutput(output);
+		return;
 	}
 
-	if (errors.empty())
+	// passes can report out of source order, a function visited before another, or
+	// several functions checked at once, so what a phase adds is ordered by location
+	auto first_error = errors.size();
+	auto first_warning = warnings.size();
+
+	if (cache)
 	{
-		TypeChecker typechecker(this);
-		auto typechecker_start = get_time();
-		typechecker.Check();
-		auto typechecker_time = get_time_diff_ms(typechecker_start);
+		auto semantics_start = get_time();
+		cache->Check();
+		auto semantics_time = get_time_diff_ms(semantics_start);
 		if (print_timing)
-			std::cout << "TypeChecker Took: " << typechecker_time << "ms" << std::endl;
+			std::cout << "TypeGenertaor + TypeChecker Took: " << semantics_time << "ms (cached, " << cache->ReusedCount()
+				<< " of " << cache->FunctionCount() << " functions reused)" << std::endl;
 	}
-	else
+	else if (fused_semantics && errors.empty())
 	{
+		auto semantics_start = get_time();
+		auto& pool = GetThreadPool();
+		auto& functions = program->functions;
+		if (pool.ThreadCount() > 1 && !lazy_bodies && functions.size() >= MIN_PARALLEL_FUNCTIONS)
+		{
+			// functions only read each other's prototypes, so each worker walks whole
+			// functions with its own passes. Each function reports into lists of its own,
+			// which worker took it changes from run to run and its order must not show
+			std::vector<FusedPass<TypeGenertaor, TypeChecker>> semantics;
+			std::vector<std::vector<Message>> function_errors(functions.size());
+			std::vector<std::vector<Message>> function_warnings(functions.size());
+			semantics.reserve(pool.ThreadCount());
+			for (size_t i = 0; i < pool.ThreadCount(); ++i)
+			{
+				semantics.emplace_back(this);
+			}
+
+			pool.ParallelForStealing(functions.size(), [&](size_t worker, size_t index)
+			{
+				semantics[worker].SetDiagnostics(&function_errors[index], &function_warnings[index]);
+				semantics[worker].Walk(functions[index]);
+			});
+
+			for (size_t i = 0; i < functions.size(); ++i)
+			{
+				errors.insert(errors.end(), function_errors[i].begin(), function_errors[i].end());
+				warnings.insert(warnings.end(), function_warnings[i].begin(), function_warnings[i].end());
+			}
+		}
+		else
+		{
+			FusedPass<TypeGenertaor, TypeChecker> semantics(this);
+			semantics.WalkFunctions();
+		}
+		auto semantics_time = get_time_diff_ms(semantics_start);
+		if (print_timing)
+			std::cout << "TypeGenertaor + TypeChecker Took: " << semantics_time << "ms (fused, " << pool.ThreadCount() << " threads)" << std::endl;
+	}
+	else if (fused_semantics)
+	{
+		std::cout << "Not Type Generating because of previous errors" << std::endl;
 		std::cout << "Not Type Checking because of previous errors" << std::endl;
 	}
+	else
+	{
+		if (errors.empty())
+		{
+			TypeGenertaor generator(this);
+			auto typegen_start = get_time();
+			generator.Generate();
+			auto typegen_time = get_time_diff_ms(typegen_start);
+			if (print_timing)
+				std::cout << "TypeGenertaor Took: " << typegen_time << "ms" << std::endl;
+		}
+		else
+		{
+			std::cout << "Not Type Generating because of previous errors" << std::endl;
+		}
+
+		if (errors.empty())
+		{
+			TypeChecker typechecker(this);
+			auto typechecker_start = get_time();
+			typechecker.Check();
+			auto typechecker_time = get_time_diff_ms(typechecker_start);
+			if (print_timing)
+				std::cout << "TypeChecker Took: " << typechecker_time << "ms" << std::endl;
+		}
+		else
+		{
+			std::cout << "Not Type Checking because of previous errors" << std::endl;
+		}
+	}
+
+	SortMessages(errors, first_error);
+	SortMessages(warnings, first_warning);
 
 	if (errors.empty())
 	{
 		CodeGen codegen(this);
 		auto codegen_start = get_time();
-		codegen.Generate(std::cout);
+		auto output = OpenOutput();
+		if (cache)
+		{
+			cache->Generate(output);
+		}
+		else
+		{
+			codegen.Generate(output);
+		}
+		CloseOutput(output);
 		auto codegen_time = get_time_diff_ms(codegen_start);
 		if (print_timing)
 			std::cout << "CodeGen Took: " << codegen_time << "ms" << std::endl;
@@ -86,164 +280,270 @@ void Context::Compile()
 		std::cout << "Not Code Generating because of previous errors" << std::endl;
 	}
 
+	if (cache)
+	{
+		cache->Save();
+	}
+
 	auto compile_time = get_time_diff_ms(compile_start);
 	if (print_timing)
 		std::cout << "Compile Total Time: " << compile_time << "ms" << std::endl;
 }
 
-void Context::CreateProgram(const std::vector<Function*>& functions, const std::vector<Statement*>& statements)
+void Context::Lex()
 {
-	program = new Program(functions, statements);
+	Lexer lexer(this);
+	auto lexer_start = get_time();
+	lexer.LexParallel(GetThreadPool());
+	auto lexer_time_us = get_time_diff_us(lexer_start);
+	if (print_timing)
+	{
+		auto throughput = lexer_time_us ? input.size() / lexer_time_us : 0;
+		std::cout << "Lexer Took: " << lexer_time_us / 1000 << "ms (" << throughput << " MB/s, "
+			<< GetLexerKernels().name << " kernels, " << GetThreadPool().ThreadCount() << " threads)" << std::endl;
+	}
+	lexed = true;
 }
 
-Type* Context::CreateType(const std::string_view& name)
+void Context::Relex(std::string_view input, const TextEdit& edit)
 {
-	Type* type = new Type{ (TypeID)(type_index++), name };
-	auto it = types.find(name);
-	if (it != types.end())
-	{
-		Error("Type " + std::string(name) + " already exists", 0, 0);
-		return nullptr;
-	}
-	types[name] = type;
-	return type;
+	Lexer lexer(this);
+	auto lexer_start = get_time();
+	lexer.Relex(input, edit);
+	auto lexer_time_us = get_time_diff_us(lexer_start);
+	if (print_timing)
+		std::cout << "Relex Took: " << lexer_time_us << "us (" << tokens.Count() << " tokens)" << std::endl;
+	lexed = true;
 }
 
-Type* Context::GetType(const std::string_view& name)
+void Context::ScanImports()
 {
-	auto it = types.find(name);
-	if (it != types.end())
+	if (!lexed)
 	{
-		return it->second;
+		Lex();
+	}
+
+	// import "path"; at the top level, a malformed one is left for the parser to report
+	import_paths.clear();
+	size_t depth = 0;
+	for (size_t i = 0; i + 2 < tokens.Count(); ++i)
+	{
+		auto kind = tokens.Kind(i);
+		if (kind == TokenType::LeftBrace)
+		{
+			depth++;
+		}
+		else if (kind == TokenType::RightBrace && depth > 0)
+		{
+			depth--;
+		}
+		else if (kind == TokenType::Import && depth == 0 && tokens.Kind(i + 1) == TokenType::StringLiteral)
+		{
+			import_paths.emplace_back(tokens.Value(i + 1));
+		}
 	}
-	Error("Type " + std::string(name) + " does not exist", 0, 0);
-	return nullptr;
 }
 
-StructDefination* Context::GetStructByType(const Type& type)
+void Context::ParseSignatures()
 {
-	auto it = structs.find(type.name);
-	if (it != structs.end())
+	lazy_bodies = true;
+	if (!lexed)
 	{
-		return it->second;
+		Lex();
 	}
 
-	Error("Struct " + std::string(type.name) + " does not exist", 0, 0);
-	return nullptr;
+	if (errors.empty())
+	{
+		ImportDeclarations();
+		Parser parser(this);
+		parser.Parse();
+	}
 }
 
-StructDefination* Context::GetStructByVariable(Variable* variable)
+void Context::ImportDeclarations()
 {
-	auto struct_name = variable->data_type.name;
-	auto it = structs.find(struct_name);
-	if (it != structs.end())
+	for (auto module : imports)
 	{
-		return it->second;
+		ImportDeclarations(*module);
 	}
-
-	Error("Struct " + std::string(struct_name) + " does not exist", 0, 0);
-	return nullptr;
 }
 
-StructDefination* Context::GetStructByVariableName(const std::string_view& name)
+void Context::ImportDeclarations(const ModuleInterface& module)
 {
-	auto struct_name = GetVariableFromScope(name)->data_type.name;
-	auto it = structs.find(struct_name);
-	if (it != structs.end())
+	// a declaration that arrives through several imports is kept once
+	auto& header = module.Header();
+	std::vector<Type> struct_types(header.structs.size());
+	std::vector<std::pair<const InterfaceStruct*, StructDefination*>> imported_structs;
+	for (size_t i = 0; i < header.structs.size(); ++i)
 	{
-		return it->second;
+		auto& defination = header.structs[i];
+		auto symbol = symbols.Intern(defination.name.View());
+		if (types.Find(symbol).id == TYPE_UNKNOWN)
+		{
+			types.Create(symbol, symbols.Name(symbol));
+			auto imported = arena.New<StructDefination>(symbols.Name(symbol), symbol, std::vector<StructField>{});
+			structs.Set(symbol, imported);
+			imported_structs.emplace_back(&defination, imported);
+		}
+		struct_types[i] = types.Find(symbol);
+	}
+
+	auto import_type = [&](uint32_t type)
+	{
+		return ModuleInterface::IsStructType(type) ? struct_types[ModuleInterface::StructIndex(type)] : Type{ (TypeID)type };
+	};
+
+	// fields can name any struct, so they are filled in once every struct has its type
+	for (auto [defination, imported] : imported_structs)
+	{
+		imported->fields.reserve(defination->fields.size());
+		for (const auto& field : defination->fields)
+		{
+			auto symbol = symbols.Intern(field.name.View());
+			imported->fields.emplace_back(symbols.Name(symbol), symbol, import_type(field.type));
+		}
 	}
 
-	Error("Struct " + std::string(struct_name) + " does not exist", 0, 0);
-	return nullptr;
+	// a function is only brought in when the source names it, nothing else could call it.
+	// A big module costs a lookup per function instead of a copy of every prototype
+	for (const auto& prototype : header.functions)
+	{
+		auto symbol = symbols.Find(prototype.name.View());
+		if (symbol == INVALID_SYMBOL || functions.Get(symbol))
+		{
+			continue;
+		}
+
+		std::vector<Parameter> params;
+		params.reserve(prototype.params.size());
+		for (const auto& param : prototype.params)
+		{
+			auto param_symbol = symbols.Intern(param.name.View());
+			params.emplace_back(symbols.Name(param_symbol), param_symbol, import_type(param.type));
+		}
+		functions.Set(symbol, arena.New<FunctionPrototype>(import_type(prototype.return_type),
+			symbols.Name(symbol), symbol, std::move(params)));
+	}
 }
 
-bool Context::HasVariable(const std::string_view& name)
+OutputBuffer Context::OpenOutput()
 {
-	return current_scope->GetVariable(name) != nullptr;
+	if (output_path)
+	{
+		// the whole text is kept so the file can be sized and mapped once
+		return OutputBuffer();
+	}
+
+	// what was printed through std::cout has to be out before the buffer writes to the descriptor
+	std::cout.flush();
+	return OutputBuffer(OutputBuffer::STANDARD_OUTPUT);
 }
 
-Variable* Context::GetVariableFromScope(const std::string_view& name)
+void Context::CloseOutput(OutputBuffer& output)
 {
-	return current_scope->GetVariable(name);
+	if (output_path)
+	{
+		if (!output.WriteToFile(output_path))
+		{
+			Error("Could not write " + std::string(output_path), 0, 0);
+		}
+	}
+	else if (!output.Flush())
+	{
+		Error("Could not write the generated code to standard output", 0, 0);
+	}
 }
 
-Variable* Context::AddVariableToScope(const std::string_view& name, Type data_type)
+ThreadPool& Context::GetThreadPool()
 {
-	current_scope->variables[name] = new Variable(name, data_type);
-	return current_scope->variables[name];
+	if (!thread_pool)
+	{
+		thread_pool = std::make_unique<ThreadPool>(thread_count);
+	}
+	return *thread_pool;
 }
 
-Type Context::GetVariableDataType(const std::string_view& name)
+Arena& Context::GetWorkerArena(size_t worker)
 {
-	auto variable = current_scope->GetVariable(name);
-	if (variable != nullptr)
+	while (worker_arenas.size() <= worker)
 	{
-		return variable->data_type;
+		worker_arenas.push_back(std::make_unique<Arena>());
 	}
+	return *worker_arenas[worker];
+}
 
-	return Type{};
+void Context::CreateProgram(std::vector<Function*> functions, std::vector<Statement*> statements)
+{
+	program = arena.New<Program>(std::move(functions), std::move(statements));
 }
 
-Scope* Context::GetParentScope()
+Type Context::CreateType(SymbolId name)
 {
-	if (current_scope->parent == -1)
+	auto type = types.Create(name, symbols.Name(name));
+	if (type.id == TYPE_UNKNOWN)
 	{
-		return root_scope;
+		Error("Type " + std::string(symbols.Name(name)) + " already exists", 0, 0);
 	}
-
-	return scopes[current_scope->parent];
+	return type;
 }
 
-Scope* Context::CreateScope()
+Type Context::GetType(SymbolId name)
 {
-	auto scope = new Scope(scopes.size(), current_scope->index, this);
-	scopes.push_back(scope);
-	current_scope = scope;
-	return scope;
+	auto type = types.Find(name);
+	if (type.id == TYPE_UNKNOWN)
+	{
+		Error("Type " + std::string(symbols.Name(name)) + " does not exist", 0, 0);
+	}
+	return type;
 }
 
-Scope* Context::GetScope(size_t index)
+StructDefination* Context::GetStructByType(const Type& type)
 {
-	return scopes[index];
+	return structs.Get(types.Symbol(type));
 }
 
-size_t Context::GetCurrentScopeIndex()
+StructDefination* Context::GetStructByVariable(Variable* variable)
 {
-	return scopes.size() - 1;
+	return GetStructByType(variable->data_type);
 }
 
-FunctionPrototype* Context::GetFunctionPrototype(const std::string_view& name)
+BlockNode* Context::GetFunctionBody(Function* function)
 {
-	auto it = functions.find(name);
-	if (it != functions.end())
+	if (function->body == nullptr)
 	{
-		return it->second;
+		if (!body_parser)
+		{
+			body_parser = std::make_unique<Parser>(this, &arena);
+		}
+		body_parser->ParseFunctionBody(function, &errors);
 	}
-
-	return nullptr;
+	return function->body;
 }
 
-Type Context::GetFunctionReturnType(const std::string_view& name)
+Variable* Context::GetDeclaration(const Variable* reference)
 {
-	auto it = functions.find(name);
-	if (it != functions.end())
+	if (reference->scope == nullptr)
 	{
-		return it->second->return_type;
+		return nullptr;
 	}
 
-	assert(false);
-	__assume(false);
+	return reference->scope->variables[reference->slot];
 }
 
-void Context::PushScope()
+FunctionPrototype* Context::GetFunctionPrototype(SymbolId name)
 {
-	current_scope = CreateScope();
+	return functions.Get(name);
 }
 
-void Context::PopScope()
+Type Context::GetFunctionReturnType(SymbolId name)
 {
-	current_scope = GetParentScope();
+	if (auto prototype = functions.Get(name))
+	{
+		return prototype->return_type;
+	}
+
+	assert(false);
+	__assume(false);
 }
 
 void Context::Error(const std::string& text, size_t line, size_t column)
@@ -267,17 +567,17 @@ void Context::Warning(const std::string& text, size_t line, size_t column)
 	warnings.push_back(message);
 }
 
-void Context::PrintMessages()
+void Context::PrintMessages(std::ostream& out)
 {
 	for (auto& message : errors)
 	{
 		if (message.line == 0)
 		{
-			std::cout << "Error: " << message.text << std::endl;
+			out << "Error: " << message.text << std::endl;
 		}
 		else
 		{
-			std::cout << "Error: " << message.text << " at line " << message.line << ", column " << message.column << std::endl;
+			out << "Error: " << message.text << " at line " << message.line << ", column " << message.column << std::endl;
 		}
 	}
 
@@ -286,11 +586,11 @@ void Context::PrintMessages()
 	{
 		if (message.line == 0)
 		{
-			std::cout << "Warning: " << message.text << std::endl;
+			out << "Warning: " << message.text << std::endl;
 		}
 		else
 		{
-			std::cout << "Warning: " << message.text << " at line " << message.line << ", column " << message.column << std::endl;
+			out << "Warning: " << message.text << " at line " << message.line << ", column " << message.column << std::endl;
 		}
 	}
 }
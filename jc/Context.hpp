@@ -4,8 +4,17 @@
 #include "Token.hpp"
 #include "AST.hpp"
 #include "Type.hpp"
+#include "Arena.hpp"
+#include "SourceBuffer.hpp"
+#include "SymbolTable.hpp"
+#include "ThreadPool.hpp"
+#include <memory>
+#include <iostream>
 
 struct Scope;
+class Parser;
+class OutputBuffer;
+class ModuleInterface;
 
 struct Message
 {
@@ -16,53 +25,108 @@ struct Message
 
 struct Context
 {
+	// owns every AST node, scope, variable and type created while compiling
+	Arena arena;
+	SourceBuffer source;
 	std::string_view input;
-	std::unordered_map<std::string_view, StructDefination*> structs;
-	std::unordered_map<std::string_view, Type*> types;
-	std::unordered_map<std::string_view, FunctionPrototype*> functions;
-	std::vector<Scope*> scopes;
-	Scope* current_scope;
+	// every identifier in the program, the tables below are keyed by its ids
+	SymbolTable symbols;
+	SymbolMap<StructDefination> structs;
+	TypeTable types;
+	SymbolMap<FunctionPrototype> functions;
+	// globals, every function scope hangs off it
 	Scope* root_scope;
 	std::vector<Message> errors;
 	std::vector<Message> warnings;
-	std::vector<Token> tokens;
+	TokenBuffer tokens;
 	Program* program;
 	bool print_timing = false;
 	bool print_warings = false;
-
-	int type_index = TYPE_VOID + 1;
+	// lex on demand while parsing instead of lexing the whole file first
+	bool stream_tokens = false;
+	// threads used inside a single compile, 0 picks one per core
+	size_t thread_count = 0;
+	// function bodies are only parsed once GetFunctionBody asks for them
+	bool lazy_bodies = false;
+	// stop after parsing and print the function declarations, no body is ever parsed
+	bool signatures_only = false;
+	// type inference and checking in one walk, the separate passes are kept to diff against
+	bool fused_semantics = true;
+	// lex, parse, check and generate one declaration at a time, see Pipeline
+	bool pipeline = false;
+	// the file this context compiles
+	std::string file_path;
+	// as written in the `import` declarations, relative to this file, see ScanImports
+	std::vector<std::string> import_paths;
+	// the declarations of the modules this one imports, directly or through other modules,
+	// brought in before parsing
+	std::vector<const ModuleInterface*> imports;
+	// the generated code is written here, nullptr writes it to standard output
+	const char* output_path = nullptr;
+	// directory of the incremental cache, nullptr compiles everything every time. Streaming
+	// and the pipeline never keep the tokens of a whole function, so they do not use it
+	const char* cache_path = nullptr;
 
 	Context(const char* file_path);
+	~Context();
+
+	// starts over on another file, everything from the last one is dropped but the memory
+	// it was in is kept, so a context compiling many files only warms up once
+	void Reset(const char* file_path);
 
 	void Compile();
+	// lexes the whole file, Compile skips that step if it was done already
+	void Lex();
+	// `input` is the input with `edit` applied, only the tokens around the edit are lexed
+	// again, see Lexer::Relex. What was parsed from the old tokens has to be parsed again.
+	// `input` has to be followed by a '\0', as it is in a std::string
+	void Relex(std::string_view input, const TextEdit& edit);
+	// fills import_paths, lexing first if needed
+	void ScanImports();
+	// parses the declarations only, enough for other modules to import this one
+	void ParseSignatures();
+	// brings the functions and structs of every module in `imports` into this context
+	void ImportDeclarations();
+	void ImportDeclarations(const ModuleInterface& module);
+
+	// where CodeGen writes to, CloseOutput writes out what is still buffered
+	OutputBuffer OpenOutput();
+	void CloseOutput(OutputBuffer& output);
+
+	// created on first use so a context that never goes parallel never starts threads
+	ThreadPool& GetThreadPool();
+	// arena for one worker of the thread pool, lives as long as the context
+	Arena& GetWorkerArena(size_t worker);
 
-	void CreateProgram(const std::vector<Function*>&, const std::vector<Statement*>&);
+	void CreateProgram(std::vector<Function*> functions, std::vector<Statement*> statements);
 
-	Type* CreateType(const std::string_view& name);
-	Type* GetType(const std::string_view& name);
+	// both report an error and return TYPE_UNKNOWN when they fail
+	Type CreateType(SymbolId name);
+	Type GetType(SymbolId name);
 
 	
+	// lookups only, nullptr when there is no such struct
 	StructDefination* GetStructByType(const Type& type);
 	StructDefination* GetStructByVariable(Variable* variable);
-	StructDefination* GetStructByVariableName(const std::string_view& name);
 
-	bool HasVariable(const std::string_view& name);
-
-	Variable* GetVariableFromScope(const std::string_view& name);
-	Variable* AddVariableToScope(const std::string_view& name, Type data_type);
-	Type GetVariableDataType(const std::string_view& name);
-	Scope* GetParentScope();
-	Scope* CreateScope();
-	Scope* GetScope(size_t index);
-	size_t GetCurrentScopeIndex();
-	FunctionPrototype* GetFunctionPrototype(const std::string_view& name);
-	Type GetFunctionReturnType(const std::string_view& name);
-
-	void PushScope();
-	void PopScope();
+	// parses the body on first use when lazy_bodies is set, not safe to call from several threads
+	BlockNode* GetFunctionBody(Function* function);
+	// the declaration a parsed reference was resolved to, nullptr if it was not found
+	Variable* GetDeclaration(const Variable* reference);
+	FunctionPrototype* GetFunctionPrototype(SymbolId name);
+	Type GetFunctionReturnType(SymbolId name);
 
 	void Error(const std::string& text, size_t line, size_t column);
 	void Warning(const std::string& text, size_t line, size_t column);
 
-	void PrintMessages();
+	void PrintMessages(std::ostream& out = std::cout);
+
+private:
+	std::unique_ptr<ThreadPool> thread_pool;
+	std::vector<std::unique_ptr<Arena>> worker_arenas;
+	// kept so lazily parsed bodies do not have to set up the globals every time
+	std::unique_ptr<Parser> body_parser;
+	bool lexed = false;
+
+	void Open(const char* file_path);
 };
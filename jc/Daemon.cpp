@@ -0,0 +1,376 @@
+#include "Daemon.hpp"
+#include "ModuleGraph.hpp"
+#include "SourceBuffer.hpp"
+#include "Utils.hpp"
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#endif
+
+// the first field of every request, a client and a daemon of different builds can differ
+constexpr char DAEMON_PROTOCOL[] = "jc-daemon-1";
+
+Daemon::Daemon(const char* socket_path)
+	: socket_path(socket_path)
+{
+}
+
+int Daemon::Serve(const std::vector<const char*>& args, std::ostream& out)
+{
+	auto serve_start = get_time();
+	if (args.size() == 1 && std::strcmp(args[0], "--stop") == 0)
+	{
+		stopping = true;
+		out << "Daemon stopped" << std::endl;
+		return 0;
+	}
+
+	Options options;
+	options.Parse(args);
+	// timing is reported for the whole request, the compiles would print theirs on the daemon's console
+	options.print_timing = false;
+	if (options.file_paths.size() > 1 && options.output_path)
+	{
+		out << "Error: -o takes a single input, every file of a batch is written next to it" << std::endl;
+		return 1;
+	}
+
+	bool failed = false;
+	size_t reused_before = reused;
+	for (auto path : options.file_paths)
+	{
+		std::ostringstream messages;
+		failed |= CompileFile(options, path, messages);
+		auto text = messages.str();
+		if (options.file_paths.size() > 1 && !text.empty())
+		{
+			out << "In " << path << ":" << std::endl;
+		}
+		out << text;
+	}
+
+	out << "Daemon Took: " << get_time_diff_ms(serve_start) << "ms (" << options.file_paths.size() << " files, "
+		<< reused - reused_before << " unchanged)" << std::endl;
+	return failed ? 1 : 0;
+}
+
+bool Daemon::CompileFile(const Options& options, const char* path, std::ostream& out)
+{
+	std::error_code error;
+	auto source_path = std::filesystem::weakly_canonical(path, error);
+	if (error)
+	{
+		source_path = std::filesystem::absolute(path).lexically_normal();
+	}
+	auto output_path = std::filesystem::absolute(options.output_path ? std::filesystem::path(options.output_path)
+		: std::filesystem::path(path).replace_extension(".cpp")).lexically_normal();
+
+	auto& file = files[source_path.string() + "\n" + options.Key() + "\n" + output_path.string()];
+	if (file.context && !file.modules && IsCurrent(file))
+	{
+		reused++;
+		out << file.messages;
+		return file.failed;
+	}
+
+	// taken before the source is read, a change made during the compile is seen next time
+	file.source_time = std::filesystem::last_write_time(source_path, error);
+	file.source_size = std::filesystem::file_size(source_path, error);
+	file.output_path = output_path.string();
+
+	auto source = source_path.string();
+	if (file.context)
+	{
+		file.context->Reset(source.c_str());
+	}
+	else
+	{
+		file.context = std::make_unique<Context>(source.c_str());
+	}
+
+	auto context = file.context.get();
+	options.Configure(context);
+	context->output_path = file.output_path.c_str();
+	std::ostringstream messages;
+	if (context->stream_tokens)
+	{
+		context->Compile();
+		context->PrintMessages(messages);
+		file.failed = !context->errors.empty();
+	}
+	else
+	{
+		ModuleGraph graph(context);
+		graph.Build();
+		graph.PrintMessages(messages);
+		file.failed = graph.HasErrors();
+	}
+	context->output_path = nullptr;
+
+	file.modules = !context->import_paths.empty();
+	file.source_hash = std::hash<std::string_view>{}(context->input);
+	file.output_time = std::filesystem::last_write_time(output_path, error);
+	file.has_output = !error;
+	file.messages = messages.str();
+	out << file.messages;
+	return file.failed;
+}
+
+bool Daemon::IsCurrent(File& file)
+{
+	std::error_code error;
+	auto& path = file.context->file_path;
+	auto time = std::filesystem::last_write_time(path, error);
+	if (error || std::filesystem::file_size(path, error) != file.source_size || error)
+	{
+		return false;
+	}
+
+	// saved again without a change, or touched by a build tool
+	if (time != file.source_time)
+	{
+		SourceBuffer source;
+		if (!source.Open(path.c_str()) || std::hash<std::string_view>{}(source.View()) != file.source_hash)
+		{
+			return false;
+		}
+		file.source_time = time;
+	}
+
+	if (file.has_output)
+	{
+		auto output_time = std::filesystem::last_write_time(file.output_path, error);
+		return !error && output_time == file.output_time;
+	}
+	return true;
+}
+
+#ifdef _WIN32
+
+// Windows has Unix domain sockets since 10 1803, the daemon is not there yet
+
+bool Daemon::Run()
+{
+	std::cout << "Error: --daemon needs Unix domain sockets, this build has none" << std::endl;
+	return false;
+}
+
+int Daemon::Request(const char* socket_path, const std::vector<const char*>& args)
+{
+	std::cout << "Error: --connect needs Unix domain sockets, this build has none" << std::endl;
+	return -1;
+}
+
+#else
+
+// a message is its size as 4 bytes followed by that many bytes, both ends are on one machine
+static bool SendFrame(int fd, std::string_view data)
+{
+	uint32_t size = (uint32_t)data.size();
+	std::string frame(reinterpret_cast<const char*>(&size), sizeof(size));
+	frame.append(data);
+	for (size_t sent = 0; sent < frame.size();)
+	{
+		auto count = write(fd, frame.data() + sent, frame.size() - sent);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			return false;
+		}
+		sent += count;
+	}
+	return true;
+}
+
+static bool ReceiveExactly(int fd, char* data, size_t size)
+{
+	for (size_t received = 0; received < size;)
+	{
+		auto count = read(fd, data + received, size - received);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			return false;
+		}
+		received += count;
+	}
+	return true;
+}
+
+static bool ReceiveFrame(int fd, std::string& data)
+{
+	uint32_t size;
+	if (!ReceiveExactly(fd, reinterpret_cast<char*>(&size), sizeof(size)))
+	{
+		return false;
+	}
+	data.resize(size);
+	return ReceiveExactly(fd, data.data(), size);
+}
+
+static bool MakeAddress(const char* path, sockaddr_un& address)
+{
+	address = {};
+	address.sun_family = AF_UNIX;
+	if (std::strlen(path) >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	std::strcpy(address.sun_path, path);
+	return true;
+}
+
+// -1 when nothing listens on `path`
+static int Connect(const char* path)
+{
+	sockaddr_un address;
+	if (!MakeAddress(path, address))
+	{
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+bool Daemon::Run()
+{
+	sockaddr_un address;
+	if (!MakeAddress(socket_path.c_str(), address))
+	{
+		std::cout << "Error: the socket path " << socket_path << " is too long" << std::endl;
+		return false;
+	}
+
+	// a daemon that answers owns the path already, a socket file nobody answers on was left
+	// behind by one that did not get to remove it
+	if (int running = Connect(socket_path.c_str()); running >= 0)
+	{
+		close(running);
+		std::cout << "Error: a daemon is running on " << socket_path << " already" << std::endl;
+		return false;
+	}
+	unlink(socket_path.c_str());
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0)
+	{
+		std::cout << "Error: could not listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+		if (listener >= 0)
+		{
+			close(listener);
+		}
+		return false;
+	}
+
+	// a client that goes away before its answer is written must not take the daemon with it
+	std::signal(SIGPIPE, SIG_IGN);
+	std::cout << "Listening on " << socket_path << std::endl;
+
+	while (!stopping)
+	{
+		int client = accept(listener, nullptr, nullptr);
+		if (client < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+			{
+				continue;
+			}
+			std::cout << "Error: accept failed: " << std::strerror(errno) << std::endl;
+			break;
+		}
+
+		// the protocol, the client's working directory, then its arguments, each ending in '\0'
+		std::string request;
+		if (ReceiveFrame(client, request))
+		{
+			std::vector<const char*> fields;
+			for (size_t begin = 0, end; (end = request.find('\0', begin)) != std::string::npos; begin = end + 1)
+			{
+				fields.push_back(request.c_str() + begin);
+			}
+
+			std::ostringstream out;
+			int32_t code = 1;
+			std::error_code error;
+			if (fields.size() < 2 || std::strcmp(fields[0], DAEMON_PROTOCOL) != 0)
+			{
+				out << "Error: the client speaks another protocol than " << DAEMON_PROTOCOL << std::endl;
+			}
+			else if (std::filesystem::current_path(fields[1], error); error)
+			{
+				out << "Error: could not change to " << fields[1] << std::endl;
+			}
+			else
+			{
+				// relative paths are the client's, clients are served one at a time so the
+				// working directory of the daemon can be theirs while it compiles
+				code = Serve(std::vector<const char*>(fields.begin() + 2, fields.end()), out);
+			}
+
+			std::string response(reinterpret_cast<const char*>(&code), sizeof(code));
+			response += out.str();
+			SendFrame(client, response);
+		}
+		close(client);
+	}
+
+	close(listener);
+	unlink(socket_path.c_str());
+	return true;
+}
+
+int Daemon::Request(const char* socket_path, const std::vector<const char*>& args)
+{
+	int fd = Connect(socket_path);
+	if (fd < 0)
+	{
+		std::cout << "Error: no daemon is listening on " << socket_path << std::endl;
+		return -1;
+	}
+
+	std::error_code error;
+	std::string request = DAEMON_PROTOCOL;
+	request += '\0';
+	request += std::filesystem::current_path(error).string();
+	request += '\0';
+	for (auto arg : args)
+	{
+		request += arg;
+		request += '\0';
+	}
+
+	std::string response;
+	bool answered = SendFrame(fd, request) && ReceiveFrame(fd, response) && response.size() >= sizeof(int32_t);
+	close(fd);
+	if (!answered)
+	{
+		std::cout << "Error: the daemon on " << socket_path << " did not answer" << std::endl;
+		return -1;
+	}
+
+	int32_t code;
+	std::memcpy(&code, response.data(), sizeof(code));
+	std::cout << std::string_view(response).substr(sizeof(code));
+	return code;
+}
+
+#endif
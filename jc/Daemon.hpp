@@ -0,0 +1,61 @@
+#pragma once
+#include "Context.hpp"
+#include "Options.hpp"
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A compiler that stays up and compiles for clients on a local socket, see `jc --daemon`.
+// A client sends the arguments it was started with and its working directory, and gets
+// back the messages jc would have printed and its exit code. Every file keeps its Context
+// between requests. A file whose source and output did not change since it was last
+// compiled is answered with the messages of that compile. Otherwise its context is reset and it is
+// compiled again. A file that imports modules always goes through ModuleGraph, which
+// finds out what changed itself. Generated code always goes to a file, <name>.cpp next
+// to the source unless -o says otherwise, a client has no standard output to write it to.
+// Clients are served one at a time, a compile still uses every thread.
+class Daemon
+{
+public:
+	explicit Daemon(const char* socket_path);
+
+	// serves clients until one sends --stop, false when the socket could not be opened
+	bool Run();
+	// sends `args` to the daemon on `socket_path` and prints its answer, returns the exit
+	// code of the compile, or -1 when no daemon answered
+	static int Request(const char* socket_path, const std::vector<const char*>& args);
+
+private:
+	struct File
+	{
+		std::unique_ptr<Context> context;
+		// of the source when it was compiled, the hash is only looked at when the time changed
+		std::filesystem::file_time_type source_time;
+		uintmax_t source_size = 0;
+		size_t source_hash = 0;
+		std::string output_path;
+		// a compile with errors writes nothing, there is no output to check then
+		bool has_output = false;
+		std::filesystem::file_time_type output_time;
+		std::string messages;
+		bool failed = false;
+		// it had imports, whether those changed is for ModuleGraph to find out
+		bool modules = false;
+	};
+
+	// what `jc args` would print and return
+	int Serve(const std::vector<const char*>& args, std::ostream& out);
+	// true when the file had errors
+	bool CompileFile(const Options& options, const char* path, std::ostream& out);
+	// the source and the output are what they were after the file was last compiled
+	bool IsCurrent(File& file);
+
+	std::string socket_path;
+	// by source path, the options and the output path, changing either compiles again
+	std::unordered_map<std::string, File> files;
+	size_t reused = 0;
+	bool stopping = false;
+};
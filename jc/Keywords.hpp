@@ -0,0 +1,116 @@
+#pragma once
+#include <string_view>
+#include <cstdint>
+#include "Token.hpp"
+
+// Keyword classification with a perfect hash that is computed at compile time.
+// The table is a constant shared by every Lexer, looking a word up costs one hash
+// of at most three characters and one string compare, with no allocation.
+
+struct Keyword
+{
+	std::string_view text;
+	TokenType type;
+};
+
+inline constexpr Keyword keyword_list[] =
+{
+	{ "fn", TokenType::Function },
+	{ "continue", TokenType::Continue },
+	{ "break", TokenType::Break },
+	{ "let", TokenType::Let },
+	{ "true", TokenType::True },
+	{ "false", TokenType::False },
+	{ "if", TokenType::If },
+	{ "else", TokenType::Else },
+	{ "return", TokenType::Return },
+	{ "for", TokenType::For },
+	{ "struct", TokenType::Struct },
+	{ "null", TokenType::Null },
+	{ "extern", TokenType::Extern },
+	{ "cpp", TokenType::Cpp },
+	{ "import", TokenType::Import },
+
+	// reserved types
+	{ "i8", TokenType::I8 },
+	{ "i16", TokenType::I16 },
+	{ "i32", TokenType::I32 },
+	{ "i64", TokenType::I64 },
+	{ "u8", TokenType::U8 },
+	{ "u16", TokenType::U16 },
+	{ "u32", TokenType::U32 },
+	{ "u64", TokenType::U64 },
+	{ "f32", TokenType::F32 },
+	{ "f64", TokenType::F64 },
+	{ "char", TokenType::Char },
+	{ "bool", TokenType::Bool },
+	{ "str", TokenType::Str },
+	{ "void", TokenType::Void },
+};
+
+constexpr size_t KEYWORD_TABLE_SIZE = 64;
+constexpr size_t KEYWORD_MIN_LENGTH = 2;
+constexpr size_t KEYWORD_MAX_LENGTH = 8;
+
+constexpr uint32_t KeywordHash(std::string_view text, uint32_t seed)
+{
+	uint32_t hash = (uint32_t)text.size();
+	hash = hash * seed + (uint8_t)text[0];
+	hash = hash * seed + (uint8_t)text[1];
+	hash = hash * seed + (uint8_t)text[text.size() - 1];
+	return (hash ^ (hash >> 11)) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+struct KeywordTable
+{
+	uint32_t seed = 0;
+	Keyword slots[KEYWORD_TABLE_SIZE] = {};
+};
+
+// tries seeds until every keyword lands in its own slot
+constexpr KeywordTable MakeKeywordTable()
+{
+	for (uint32_t seed = 1; seed < 100000; seed++)
+	{
+		KeywordTable table;
+		table.seed = seed;
+		bool collision = false;
+		for (const auto& keyword : keyword_list)
+		{
+			auto& slot = table.slots[KeywordHash(keyword.text, seed)];
+			if (!slot.text.empty())
+			{
+				collision = true;
+				break;
+			}
+			slot = keyword;
+		}
+		if (!collision)
+			return table;
+	}
+	return KeywordTable{};
+}
+
+inline constexpr KeywordTable keyword_table = MakeKeywordTable();
+static_assert(keyword_table.seed != 0, "no collision free seed for the keyword table");
+
+constexpr TokenType LookupKeyword(std::string_view text)
+{
+	if (text.size() < KEYWORD_MIN_LENGTH || text.size() > KEYWORD_MAX_LENGTH)
+		return TokenType::Identifier;
+
+	const auto& slot = keyword_table.slots[KeywordHash(text, keyword_table.seed)];
+	return slot.text == text ? slot.type : TokenType::Identifier;
+}
+
+constexpr bool KeywordTableIsComplete()
+{
+	for (const auto& keyword : keyword_list)
+	{
+		if (LookupKeyword(keyword.text) != keyword.type)
+			return false;
+	}
+	return LookupKeyword("point") == TokenType::Identifier && LookupKeyword("u6") == TokenType::Identifier;
+}
+
+static_assert(KeywordTableIsComplete(), "keyword table lookup is broken");
@@ -1,379 +1,735 @@
 #include "Lexer.hpp"
+#include "Keywords.hpp"
 #include <string>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+// below this the threads cost more than they save
+static constexpr size_t MIN_PARALLEL_LEX_SIZE = 1024 * 1024;
+static constexpr size_t MIN_LEX_CHUNK_SIZE = 256 * 1024;
 
 Lexer::Lexer(Context* context)
+	: Lexer(context, &context->tokens, &context->symbols, &context->errors)
+{
+}
+
+Lexer::Lexer(Context* context, TokenBuffer* tokens, SymbolTable* symbols, std::vector<Message>* errors)
 	:context(context)
 	, cursor(0)
 	, line(1)
 	, column(0)
+	, end(context->input.size())
+	, tokens(tokens)
+	, symbols(symbols)
+	, errors(errors)
+	, kernels(GetLexerKernels())
+{
+}
 
+bool Lexer::Begin()
 {
-	keywords["fn"] = TokenType::Function;
-	keywords["continue"] = TokenType::Continue;
-	keywords["break"] = TokenType::Break;
-	keywords["let"] = TokenType::Let;
-	keywords["true"] = TokenType::True;
-	keywords["false"] = TokenType::False;
-	keywords["if"] = TokenType::If;
-	keywords["else"] = TokenType::Else;
-	keywords["return"] = TokenType::Return;
-	keywords["for"] = TokenType::For;
-	keywords["struct"] = TokenType::Struct;
-	keywords["null"] = TokenType::Null;
-	keywords["extern"] = TokenType::Extern;
-	keywords["cpp"] = TokenType::Cpp;
-
-	// reserved types
-	keywords["i8"] = TokenType::I8;
-	keywords["i16"] = TokenType::I16;
-	keywords["i32"] = TokenType::I32;
-	keywords["i64"] = TokenType::I64;
-	keywords["u8"] = TokenType::U8;
-	keywords["u6"] = TokenType::U16;
-	keywords["u32"] = TokenType::U32;
-	keywords["u64"] = TokenType::U64;
-	keywords["f32"] = TokenType::F32;
-	keywords["f64"] = TokenType::F64;
-	keywords["char"] = TokenType::Char;
-	keywords["bool"] = TokenType::Bool;
-	keywords["str"] = TokenType::Str;
-	keywords["void"] = TokenType::Void;
+	// token offsets and lengths are stored as 32 bit values
+	if (context->input.size() >= UINT32_MAX)
+	{
+		Error("Input is too large, the limit is 4GB", 0, 0);
+		return false;
+	}
+
+	tokens->source = context->input;
+	tokens->symbols = symbols;
+	return true;
 }
 
 void Lexer::Lex()
 {
-	while (cursor < context->input.size())
+	if (!Begin())
+		return;
+
+	// most tokens are a couple of bytes long, reserving up front avoids regrowing four arrays
+	tokens->Reserve(context->input.size() / 2 + 1);
+
+	while (true)
 	{
 		SkipWhitespace();
+		if (cursor >= end)
+			break;
 
-		TokenType type = TokenType::None;
-		std::string_view value;
-		size_t current_line = line;
-		size_t current_column = column;
+		LexToken();
+	}
+
+	tokens->Push(TokenType::EndOfFile, (uint32_t)context->input.size(), 0, 0);
+}
 
-		switch (Peek())
+void Lexer::LexNext()
+{
+	auto count = tokens->Count();
+	while (tokens->Count() == count)
+	{
+		SkipWhitespace();
+		if (cursor < end)
 		{
-		case '+':
-			type = TokenType::Plus;
-			Eat();
-			break;
-		case '-':
-			type = TokenType::Minus;
-			Eat();
-			break;
-		case '*':
-			if (Peek(1) == '*')
-			{
-				type = TokenType::Star;
-				Eat();
-				Eat();
-			}
-			else if (Peek(1) == '=')
-			{
-				type = TokenType::StarEqual;
-				Eat();
-				Eat();
-			}
-			else
-			{
-				type = TokenType::Star;
-				Eat();
-			}
-			break;
-		case '%':
-			if (Peek(1) == '=')
-			{
-				type = TokenType::ModuloEqual;
-				Eat();
-				Eat();
-			}
-			else
-			{
-				type = TokenType::Modulo;
-				Eat();
-			}
-			break;
-		case '\\':
-			type = TokenType::BackSlash;
-			Eat();
-			break;
-		case '/':
-			if (Peek(1) == '/')
-			{
-				SkipToNextLine();
-			}
-			else if (Peek(1) == '=')
-			{
-				type = TokenType::SlashEqual;
-				Eat();
-				Eat();
-			}
-			else
-			{
-				type = TokenType::Slash;
-				Eat();
-			}
-			break;
-		case '(':
-			type = TokenType::LeftParen;
-			Eat();
-			break;
-		case ')':
-			type = TokenType::RightParen;
-			Eat();
-			break;
-		case '=':
-			if (Peek(1) == '=')
-			{
-				type = TokenType::EqualEqual;
-				Eat();
-				Eat();
-			}
-			else
-			{
-				type = TokenType::Equal;
-				Eat();
-			}
-			break;
-		case '!':
-			if (Peek(1) == '=')
-			{
-				type = TokenType::NotEqual;
-				Eat();
-				Eat();
-			}
-			else
-			{
-				type = TokenType::Not;
-				Eat();
-			}
-			break;
+			LexToken();
+		}
+		else
+		{
+			// keeps answering with EndOfFile once the input is exhausted
+			tokens->Push(TokenType::EndOfFile, (uint32_t)context->input.size(), 0, 0);
+		}
+	}
+}
 
-		case '>':
-			if (Peek(1) == '=')
-			{
-				type = TokenType::GreaterThanEqual;
-				Eat();
-				Eat();
-			}
+// offset of the first character on the line of `offset`
+static size_t LineStart(std::string_view input, size_t offset)
+{
+	while (offset > 0 && input[offset - 1] != '\n')
+	{
+		offset--;
+	}
+	return offset;
+}
+
+void Lexer::Relex(std::string_view input, const TextEdit& edit)
+{
+	// Peek reads the byte after the last one instead of checking the bounds
+	assert(input.data()[input.size()] == '\0');
+	auto old_input = tokens->source;
+	context->input = input;
+	end = input.size();
+	if (tokens->Count() == 0)
+	{
+		Lex();
+		return;
+	}
+	if (input.size() >= UINT32_MAX)
+	{
+		Error("Input is too large, the limit is 4GB", 0, 0);
+		return;
+	}
+
+	// an old token at or after the end of the edit is this far from where it is now
+	auto inserted_end = edit.begin + edit.text.size();
+	auto offset_shift = (int64_t)inserted_end - (int64_t)edit.end;
+	auto eof = tokens->Count() - 1;
+	// the first token from `low` on that starts at or after `offset`
+	auto find = [&](size_t low, size_t offset)
+	{
+		auto high = eof;
+		while (low < high)
+		{
+			auto middle = low + (high - low) / 2;
+			if (tokens->Offset(middle) < offset)
+				low = middle + 1;
 			else
-			{
-				type = TokenType::GreaterThan;
-				Eat();
-			}
+				high = middle;
+		}
+		return low;
+	};
+
+	// a token is lexed the same as long as the text from its start on is, except that the
+	// one before the edit can grow into it, "a" + "b" is a single identifier
+	size_t first = find(0, edit.begin);
+	if (first > 0)
+	{
+		first--;
+	}
+
+	TokenBuffer window;
+	window.source = input;
+	window.symbols = symbols;
+	std::vector<Message> window_errors;
+	Lexer lexer(context, &window, symbols, &window_errors);
+	// the text before the edit did not change, so the first token is where it was
+	lexer.cursor = first < eof && tokens->Offset(first) < edit.begin ? tokens->Offset(first) : 0;
+	lexer.line = lexer.cursor != 0 ? tokens->Line(first) : 1;
+	lexer.column = lexer.cursor - LineStart(input, lexer.cursor);
+	auto first_line = lexer.line;
+	auto first_column = lexer.column;
+
+	// the old tokens that could still be met, the ones starting inside the edit are gone
+	size_t old = find(first, edit.end);
+	size_t sync = eof;
+	while (true)
+	{
+		lexer.SkipWhitespace();
+		if (lexer.cursor >= lexer.end)
 			break;
 
-		case '<':
-			if (Peek(1) == '=')
+		if (lexer.cursor >= inserted_end)
+		{
+			auto old_offset = (int64_t)lexer.cursor - offset_shift;
+			while (old < eof && tokens->Offset(old) < old_offset)
 			{
-				type = TokenType::LessThanEqual;
-				Eat();
-				Eat();
+				old++;
 			}
-			else
+			if (old < eof && tokens->Offset(old) == old_offset)
 			{
-				type = TokenType::LessThan;
-				Eat();
+				sync = old;
+				break;
 			}
-			break;
+		}
+		lexer.LexToken();
+	}
 
-		case '&':
-			if (Peek(1) == '&')
+	int64_t line_shift = 0;
+	size_t sync_line = SIZE_MAX;
+	size_t sync_column = 0;
+	int64_t column_shift = 0;
+	if (sync != eof)
+	{
+		sync_line = tokens->Line(sync);
+		sync_column = tokens->Offset(sync) - LineStart(old_input, tokens->Offset(sync));
+		line_shift = (int64_t)lexer.line - (int64_t)sync_line;
+		column_shift = (int64_t)lexer.column - (int64_t)sync_column;
+	}
+
+	// errors are in the order they were found, those before the window stay, those in it
+	// were found again and those after it move like the tokens around them
+	auto before = [](const Message& message, size_t line, size_t column)
+	{
+		return message.line < line || (message.line == line && message.column < column);
+	};
+	std::vector<Message> relexed;
+	relexed.reserve(errors->size() + window_errors.size());
+	size_t i = 0;
+	for (; i < errors->size() && ((*errors)[i].line == 0 || before((*errors)[i], first_line, first_column)); i++)
+	{
+		relexed.push_back(std::move((*errors)[i]));
+	}
+	relexed.insert(relexed.end(), window_errors.begin(), window_errors.end());
+	for (; i < errors->size(); i++)
+	{
+		auto& message = (*errors)[i];
+		if (message.line == 0 || !before(message, sync_line, sync_column))
+		{
+			if (message.line == sync_line)
 			{
-				type = TokenType::And;
-				Eat();
-				Eat();
+				message.column += column_shift;
 			}
-			else
+			if (message.line != 0)
 			{
-				type = TokenType::BitAnd;
-				Eat();
+				message.line += line_shift;
 			}
+			relexed.push_back(std::move(message));
+		}
+	}
+	*errors = std::move(relexed);
+
+	tokens->Splice(first, sync, window, offset_shift, line_shift);
+	tokens->source = input;
+}
+
+struct Lexer::Chunk
+{
+	TokenBuffer tokens;
+	SymbolTable symbols;
+	std::vector<Message> errors;
+	size_t begin = 0;
+	// the next chunk has to start here, past the end when the last token ran over it
+	size_t resume = 0;
+	// newlines in [begin, resume)
+	size_t newlines = 0;
+};
+
+void Lexer::LexChunk(Chunk& chunk, size_t begin, size_t end)
+{
+	chunk.tokens.Clear();
+	chunk.symbols.Clear();
+	chunk.errors.clear();
+	chunk.begin = begin;
+
+	this->end = end;
+	cursor = begin;
+	line = 1;
+	column = 0;
+	// only a chunk that was moved by the fix up can start in the middle of a line
+	while (column < begin && context->input[begin - column - 1] != '\n')
+	{
+		column++;
+	}
+
+	auto token_end = cursor;
+	auto token_end_line = line;
+	while (true)
+	{
+		SkipWhitespace();
+		if (cursor >= end)
 			break;
 
-		case '|':
-			if (Peek(1) == '|')
-			{
-				type = TokenType::Or;
-				Eat();
-				Eat();
-			}
-			else
+		LexToken();
+		token_end = cursor;
+		token_end_line = line;
+	}
+
+	if (token_end > end)
+	{
+		chunk.resume = token_end;
+		chunk.newlines = token_end_line - 1;
+	}
+	else
+	{
+		// whitespace after the last token may have been skipped past the end, the next
+		// chunk skips the same whitespace so it only counts up to the end
+		chunk.resume = end;
+		chunk.newlines = token_end_line - 1 + std::count(context->input.data() + token_end, context->input.data() + end, '\n');
+	}
+}
+
+void Lexer::LexParallel(ThreadPool& pool)
+{
+	auto size = context->input.size();
+	auto chunk_count = std::min(pool.ThreadCount() * 4, size / MIN_LEX_CHUNK_SIZE);
+	if (pool.ThreadCount() == 1 || size < MIN_PARALLEL_LEX_SIZE || chunk_count < 2)
+	{
+		Lex();
+		return;
+	}
+
+	if (!Begin())
+		return;
+
+	// chunks start right after a newline, so unless a string, comment or cpp block
+	// spans the boundary each one starts on a token like the serial lexer would
+	std::vector<size_t> bounds(chunk_count + 1);
+	bounds[0] = 0;
+	bounds[chunk_count] = size;
+	for (size_t i = 1; i < chunk_count; i++)
+	{
+		auto split = std::max(size * i / chunk_count, bounds[i - 1]);
+		auto newline = static_cast<const char*>(std::memchr(context->input.data() + split, '\n', size - split));
+		bounds[i] = newline ? newline - context->input.data() + 1 : size;
+	}
+
+	std::vector<Chunk> chunks(chunk_count);
+	pool.ParallelFor(chunk_count, [&](size_t i)
+	{
+		auto& chunk = chunks[i];
+		Lexer lexer(context, &chunk.tokens, &chunk.symbols, &chunk.errors);
+		chunk.tokens.Reserve((bounds[i + 1] - bounds[i]) / 2 + 1);
+		lexer.LexChunk(chunk, bounds[i], bounds[i + 1]);
+	});
+
+	// a token that ran over a boundary means the next chunk started inside of it,
+	// that chunk is lexed again from where the token really ended
+	for (size_t i = 1; i < chunk_count; i++)
+	{
+		auto resume = chunks[i - 1].resume;
+		if (chunks[i].begin != resume)
+		{
+			Lexer lexer(context, &chunks[i].tokens, &chunks[i].symbols, &chunks[i].errors);
+			lexer.LexChunk(chunks[i], std::min(resume, bounds[i + 1]), bounds[i + 1]);
+			chunks[i].resume = std::max(chunks[i].resume, resume);
+		}
+	}
+
+	// interning the chunk symbols in order hands out the same ids as a serial lex
+	std::vector<std::vector<SymbolId>> remaps(chunk_count);
+	std::vector<size_t> first_token(chunk_count + 1, 0);
+	std::vector<size_t> first_line(chunk_count, 0);
+	size_t newlines = 0;
+	for (size_t i = 0; i < chunk_count; i++)
+	{
+		auto& chunk = chunks[i];
+		remaps[i].resize(chunk.symbols.Count());
+		for (SymbolId id = 0; id < chunk.symbols.Count(); id++)
+		{
+			remaps[i][id] = symbols->Intern(chunk.symbols.Name(id));
+		}
+
+		first_token[i + 1] = first_token[i] + chunk.tokens.Count();
+		first_line[i] = newlines;
+		newlines += chunk.newlines;
+
+		for (auto message : chunk.errors)
+		{
+			if (message.line != 0)
 			{
-				type = TokenType::BitOr;
-				Eat();
+				message.line += first_line[i];
 			}
-			break;
+			errors->push_back(message);
+		}
+	}
+
+	auto total = first_token[chunk_count];
+	tokens->kinds.resize(total);
+	tokens->offsets.resize(total);
+	tokens->data.resize(total);
+	tokens->lines.resize(total);
+	tokens->count = total;
+
+	pool.ParallelFor(chunk_count, [&](size_t i)
+	{
+		const auto& chunk = chunks[i];
+		auto at = first_token[i];
+		for (size_t j = 0; j < chunk.tokens.Count(); j++, at++)
+		{
+			auto kind = chunk.tokens.kinds[j];
+			tokens->kinds[at] = kind;
+			tokens->offsets[at] = chunk.tokens.offsets[j];
+			tokens->data[at] = kind == TokenType::Identifier ? remaps[i][chunk.tokens.data[j]] : chunk.tokens.data[j];
+			tokens->lines[at] = chunk.tokens.lines[j] + (uint32_t)first_line[i];
+		}
+	});
 
-		case '~':
-			type = TokenType::BitNot;
+	tokens->Push(TokenType::EndOfFile, (uint32_t)size, 0, 0);
+}
+
+void Lexer::Error(const std::string& text, size_t line, size_t column)
+{
+	errors->push_back(Message{ text, line, column });
+}
+
+void Lexer::LexToken()
+{
+	TokenType type = TokenType::None;
+	size_t token_start = cursor;
+	std::string_view value;
+	size_t current_line = line;
+	size_t current_column = column;
+
+	switch (Peek())
+	{
+	case '+':
+		type = TokenType::Plus;
+		Eat();
+		break;
+	case '-':
+		type = TokenType::Minus;
+		Eat();
+		break;
+	case '*':
+		if (Peek(1) == '*')
+		{
+			type = TokenType::Star;
 			Eat();
-			break;
+			Eat();
+		}
+		else if (Peek(1) == '=')
+		{
+			type = TokenType::StarEqual;
+			Eat();
+			Eat();
+		}
+		else
+		{
+			type = TokenType::Star;
+			Eat();
+		}
+		break;
+	case '%':
+		if (Peek(1) == '=')
+		{
+			type = TokenType::ModuloEqual;
+			Eat();
+			Eat();
+		}
+		else
+		{
+			type = TokenType::Modulo;
+			Eat();
+		}
+		break;
+	case '\\':
+		type = TokenType::BackSlash;
+		Eat();
+		break;
+	case '/':
+		if (Peek(1) == '/')
+		{
+			SkipToNextLine();
+		}
+		else if (Peek(1) == '=')
+		{
+			type = TokenType::SlashEqual;
+			Eat();
+			Eat();
+		}
+		else
+		{
+			type = TokenType::Slash;
+			Eat();
+		}
+		break;
+	case '(':
+		type = TokenType::LeftParen;
+		Eat();
+		break;
+	case ')':
+		type = TokenType::RightParen;
+		Eat();
+		break;
+	case '=':
+		if (Peek(1) == '=')
+		{
+			type = TokenType::EqualEqual;
+			Eat();
+			Eat();
+		}
+		else
+		{
+			type = TokenType::Equal;
+			Eat();
+		}
+		break;
+	case '!':
+		if (Peek(1) == '=')
+		{
+			type = TokenType::NotEqual;
+			Eat();
+			Eat();
+		}
+		else
+		{
+			type = TokenType::Not;
+			Eat();
+		}
+		break;
 
-		case '^':
-			type = TokenType::BitXor;
+	case '>':
+		if (Peek(1) == '=')
+		{
+			type = TokenType::GreaterThanEqual;
 			Eat();
-			break;
+			Eat();
+		}
+		else
+		{
+			type = TokenType::GreaterThan;
+			Eat();
+		}
+		break;
 
-		case ',':
-			type = TokenType::Comma;
+	case '<':
+		if (Peek(1) == '=')
+		{
+			type = TokenType::LessThanEqual;
 			Eat();
-			break;
-		case '.':
-			type = TokenType::Dot;
 			Eat();
-			break;
+		}
+		else
+		{
+			type = TokenType::LessThan;
+			Eat();
+		}
+		break;
 
-		case ';':
-			type = TokenType::SemiColon;
+	case '&':
+		if (Peek(1) == '&')
+		{
+			type = TokenType::And;
 			Eat();
-			break;
+			Eat();
+		}
+		else
+		{
+			type = TokenType::BitAnd;
+			Eat();
+		}
+		break;
 
-		case '"':
+	case '|':
+		if (Peek(1) == '|')
 		{
+			type = TokenType::Or;
 			Eat();
-			type = TokenType::StringLiteral;
-			auto _start = context->input.data() + cursor;
-			size_t start = column;
-			size_t end = 0;
-			while (Peek() != '"')
+			Eat();
+		}
+		else
+		{
+			type = TokenType::BitOr;
+			Eat();
+		}
+		break;
+
+	case '~':
+		type = TokenType::BitNot;
+		Eat();
+		break;
+
+	case '^':
+		type = TokenType::BitXor;
+		Eat();
+		break;
+
+	case ',':
+		type = TokenType::Comma;
+		Eat();
+		break;
+	case '.':
+		type = TokenType::Dot;
+		Eat();
+		break;
+
+	case ';':
+		type = TokenType::SemiColon;
+		Eat();
+		break;
+
+	case '"':
+	{
+		Eat();
+		type = TokenType::StringLiteral;
+		auto _start = context->input.data() + cursor;
+		size_t start = column;
+		size_t end = 0;
+		while (Peek() != '"' && cursor < context->input.size())
+		{
+			if (Peek() == '\n')
 			{
-				if (Peek() == '\n')
-				{
-					line++;
-					end = column;
-					column = 0;
-					Eat();
-					break;
-				}
+				line++;
+				end = column;
+				column = 0;
 				Eat();
+				break;
 			}
-			if (end == 0)
-				end = column;
-
-			value = std::string_view(_start, (end - start));
 			Eat();
-			break;
 		}
+		if (end == 0)
+			end = column;
 
-		case ':':
-			type = TokenType::Colon;
+		value = std::string_view(_start, (end - start));
+		if (cursor < context->input.size())
+		{
 			Eat();
-			break;
+		}
+		else
+		{
+			Error("Unterminated string literal", current_line, current_column);
+		}
+		break;
+	}
 
-		case '{':
-			type = TokenType::LeftBrace;
-			Eat();
-			break;
+	case ':':
+		type = TokenType::Colon;
+		Eat();
+		break;
 
-		case '}':
-			type = TokenType::RightBrace;
-			Eat();
-			break;
+	case '{':
+		type = TokenType::LeftBrace;
+		Eat();
+		break;
 
-		case '\0':
-			type = TokenType::EndOfFile;
-			break;
+	case '}':
+		type = TokenType::RightBrace;
+		Eat();
+		break;
 
-		default:
+	default:
 
-			if (std::isalpha(Peek()))
-			{
+		if (IsAlphaChar(Peek()))
+		{
 
-				auto _start = context->input.data() + cursor;
-				auto start = column;
-				while (std::isalnum(Peek()))
-				{
-					Eat();
-				}
-				auto end = column;
-				value = std::string_view(_start, (end - start));
+			auto _start = context->input.data() + cursor;
+			auto start = column;
+			auto identifier_length = kernels.identifier_length(_start, context->input.data() + context->input.size());
+			cursor += identifier_length;
+			column += identifier_length;
+			auto end = column;
+			value = std::string_view(_start, (end - start));
 
-				auto is_found = keywords.find(value);
-				int length = 0;
-				if (is_found != keywords.end())
-				{
-					type = is_found->second;
+			type = LookupKeyword(value);
+			int length = 0;
+			if (type == TokenType::Cpp)
+			{
+				Eat();
+				int blocks = 1;
+				auto cpp_start = context->input.data() + cursor;
+				auto cpp_start_column = column;
 
-					if (type == TokenType::Cpp)
+				while (blocks != 0 && cursor < context->input.size())
+				{
+					if(Peek() == '{')
 					{
-						Eat();
-						int blocks = 1;
-						auto cpp_start = context->input.data() + cursor;
-						auto cpp_start_column = column;
-
-						while (blocks != 0)
+						blocks++;
+					}
+					else if (Peek() == '}')
+					{
+						blocks--;
+						if (blocks == 1)
 						{
-							if(Peek() == '{')
-							{
-								blocks++;
-							}
-							else if (Peek() == '}')
-							{
-								blocks--;
-								if (blocks == 1)
-								{
-									blocks = 0;
-								}
-							}
-
-							Eat();
-							length++;
+							blocks = 0;
 						}
-
-						value = std::string_view(cpp_start, length);
-						Eat();
 					}
+
+					Eat();
+					length++;
 				}
-				else
+
+				value = std::string_view(cpp_start, length);
+				if (cursor < context->input.size())
 				{
-					type = TokenType::Identifier;
+					Eat();
+				}
+				else if (blocks != 0)
+				{
+					Error("Unterminated cpp block", current_line, current_column);
 				}
-
-			}
-			else if (std::isdigit(Peek()))
-			{
-				value = LexNumber();
-				type = TokenType::Number;
-			}
-			else if (std::isspace(Peek()))
-			{
-				Eat();
-			}
-			else {
-				// unknown token
-				context->Error("Unknown token", current_line, current_column);
-				Eat();
 			}
-		}
 
-		if (type != TokenType::None)
+		}
+		else if (IsDigitChar(Peek()))
 		{
-			Token token(type, value, current_line, current_column);
-			context->tokens.push_back(token);
+			value = LexNumber();
+			type = TokenType::Number;
+		}
+		else if (IsSpaceChar(Peek()))
+		{
+			Eat();
+		}
+		else {
+			// unknown token
+			Error("Unknown token", current_line, current_column);
+			Eat();
 		}
 	}
 
-
-	Token token(TokenType::EndOfFile, "", 0, 0);
-	context->tokens.push_back(token);
+	if (type == TokenType::Identifier)
+	{
+		tokens->Push(type, (uint32_t)token_start, symbols->Intern(value), (uint32_t)current_line);
+	}
+	else if (type != TokenType::None)
+	{
+		tokens->Push(type, (uint32_t)token_start, (uint32_t)value.size(), (uint32_t)current_line);
+	}
 }
 
 
 void Lexer::SkipWhitespace()
 {
-	while (std::isspace(Peek()))
+	// most runs between tokens are empty or a single space, only longer ones
+	// (newlines and indentation) are worth a call into the kernel
+	if (!IsSpaceChar(Peek()))
+	{
+		return;
+	}
+	if (!IsSpaceChar(Peek(1)))
 	{
 		Eat();
+		return;
+	}
+
+	auto begin = context->input.data() + cursor;
+	auto run = kernels.skip_whitespace(begin, context->input.data() + context->input.size());
+	cursor += run.length;
+
+	if (run.newlines != 0)
+	{
+		line += run.newlines;
+		column = run.length - run.last_newline - 1;
+	}
+	else
+	{
+		column += run.length;
 	}
 }
 
 void Lexer::SkipToNextLine()
 {
-	while (Peek() != '\n' && cursor < context->input.size())
-	{
-		Eat();
-	}
+	auto begin = context->input.data() + cursor;
+	auto newline = kernels.find_newline(begin, context->input.data() + context->input.size());
+	cursor += newline - begin;
+	column += newline - begin;
+
 	if (Peek() == '\n')
 	{
 		Eat();
@@ -382,12 +738,9 @@ void Lexer::SkipToNextLine()
 
 char Lexer::Peek(int offset)
 {
-	if (cursor + offset >= context->input.size())
-	{
-		return '\0';
-	}
-
-	return context->input[cursor + offset];
+	// the source buffer guarantees a '\0' right after the input, and the lexer
+	// never looks further ahead than that
+	return context->input.data()[cursor + offset];
 }
 
 char Lexer::Eat()
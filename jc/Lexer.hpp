@@ -1,17 +1,41 @@
 #pragma once
 #include "Token.hpp"
 #include "Context.hpp"
+#include "LexerKernels.hpp"
+#include "ThreadPool.hpp"
 #include <vector>
-#include <unordered_map>
 
 
 class Lexer {
 public:
 	explicit Lexer(Context*);
+	// lexes into its own buffers, used for the chunks of a parallel lex
+	explicit Lexer(Context*, TokenBuffer* tokens, SymbolTable* symbols, std::vector<Message>* errors);
 
+	// lexes the whole input into context->tokens
 	void Lex();
+	// same tokens as Lex, but the input is split into chunks that are lexed on the pool
+	void LexParallel(ThreadPool& pool);
+
+	// `input` is the input the tokens were lexed from with `edit` applied, the old input has to
+	// be alive until Relex returns. Lexing starts again at the last token before the edit and
+	// stops as soon as a token starts where one of the old input did, the tokens from there
+	// on are kept and moved. The lex errors around the edit are replaced the same way, so
+	// the errors may only hold lex errors. Like a SourceBuffer the new input has to be followed
+	// by a '\0' the lexer can peek at, the text of a std::string is
+	void Relex(std::string_view input, const TextEdit& edit);
+
+	// streaming use: Begin once, then every LexNext appends at least one token
+	bool Begin();
+	void LexNext();
 
 private:
+	struct Chunk;
+
+	void LexToken();
+	void LexChunk(Chunk& chunk, size_t begin, size_t end);
+	void Error(const std::string& text, size_t line, size_t column);
+
 	void SkipWhitespace();
 	void SkipToNextLine();
 	char Peek(int offset = 0);
@@ -25,6 +49,10 @@ private:
 	size_t column;
 	Context* context;
 	size_t cursor = 0;
-
-	std::unordered_map<std::string_view, TokenType> keywords;
-};
\ No newline at end of file
+	// where lexing stops, tokens that start before it may still run past it
+	size_t end = 0;
+	TokenBuffer* tokens;
+	SymbolTable* symbols;
+	std::vector<Message>* errors;
+	const LexerKernels& kernels;
+};
@@ -0,0 +1,304 @@
+#include "LexerKernels.hpp"
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define JC_LEXER_X64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define JC_TARGET_AVX2
+#else
+#define JC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static WhitespaceRun SkipWhitespaceScalar(const char* begin, const char* end)
+{
+	WhitespaceRun run{ 0, 0, 0 };
+	auto p = begin;
+	while (p < end && IsSpaceChar(*p))
+	{
+		if (*p == '\n')
+		{
+			run.newlines++;
+			run.last_newline = p - begin;
+		}
+		p++;
+	}
+	run.length = p - begin;
+	return run;
+}
+
+static size_t IdentifierLengthScalar(const char* begin, const char* end)
+{
+	auto p = begin;
+	while (p < end && IsAlnumChar(*p))
+	{
+		p++;
+	}
+	return p - begin;
+}
+
+static const char* FindNewlineScalar(const char* begin, const char* end)
+{
+	auto found = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+	return found ? found : end;
+}
+
+// adds the scalar tail of a run that was started by one of the vector loops
+static WhitespaceRun FinishWhitespaceRun(WhitespaceRun run, const char* begin, const char* p, const char* end)
+{
+	auto tail = SkipWhitespaceScalar(p, end);
+	if (tail.newlines)
+	{
+		run.newlines += tail.newlines;
+		run.last_newline = (p - begin) + tail.last_newline;
+	}
+	run.length = (p - begin) + tail.length;
+	return run;
+}
+
+// folds the newlines of one block into the run, `length` is how many bytes of the block are whitespace
+static void CountRunNewlines(WhitespaceRun& run, uint32_t newlines, uint32_t length, size_t block_offset)
+{
+	if (length < 32)
+	{
+		newlines &= (1u << length) - 1;
+	}
+
+	if (newlines)
+	{
+		run.newlines += std::popcount(newlines);
+		run.last_newline = block_offset + 31 - std::countl_zero(newlines);
+	}
+}
+
+#ifdef JC_LEXER_X64
+
+// ' ' or '\t'..'\r', done as an unsigned range check on (c - '\t')
+static inline __m128i SpaceMask128(__m128i bytes)
+{
+	auto shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+	auto control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+	return _mm_or_si128(control, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+}
+
+// '0'..'9', 'a'..'z' or 'A'..'Z'
+static inline __m128i AlnumMask128(__m128i bytes)
+{
+	auto digits = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+	auto is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+	auto letters = _mm_sub_epi8(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	auto is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letters, _mm_set1_epi8(25)), letters);
+	return _mm_or_si128(is_digit, is_letter);
+}
+
+static WhitespaceRun SkipWhitespaceSse2(const char* begin, const char* end)
+{
+	WhitespaceRun run{ 0, 0, 0 };
+	auto p = begin;
+	while (end - p >= 16)
+	{
+		auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		uint32_t spaces = (uint32_t)_mm_movemask_epi8(SpaceMask128(bytes));
+		uint32_t newlines = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+		uint32_t length = std::countr_zero(~spaces | 0x10000u);
+
+		CountRunNewlines(run, newlines, length, p - begin);
+		p += length;
+		if (length < 16)
+		{
+			run.length = p - begin;
+			return run;
+		}
+	}
+	return FinishWhitespaceRun(run, begin, p, end);
+}
+
+static size_t IdentifierLengthSse2(const char* begin, const char* end)
+{
+	auto p = begin;
+	while (end - p >= 16)
+	{
+		auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		uint32_t alnum = (uint32_t)_mm_movemask_epi8(AlnumMask128(bytes));
+		uint32_t length = std::countr_zero(~alnum | 0x10000u);
+		p += length;
+		if (length < 16)
+		{
+			return p - begin;
+		}
+	}
+	return (p - begin) + IdentifierLengthScalar(p, end);
+}
+
+static const char* FindNewlineSse2(const char* begin, const char* end)
+{
+	auto p = begin;
+	auto newline = _mm_set1_epi8('\n');
+	while (end - p >= 16)
+	{
+		auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+		if (mask)
+		{
+			return p + std::countr_zero(mask);
+		}
+		p += 16;
+	}
+	return FindNewlineScalar(p, end);
+}
+
+JC_TARGET_AVX2 static inline __m256i SpaceMask256(__m256i bytes)
+{
+	auto shifted = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+	auto control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+	return _mm256_or_si256(control, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')));
+}
+
+JC_TARGET_AVX2 static inline __m256i AlnumMask256(__m256i bytes)
+{
+	auto digits = _mm256_sub_epi8(bytes, _mm256_set1_epi8('0'));
+	auto is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digits, _mm256_set1_epi8(9)), digits);
+	auto letters = _mm256_sub_epi8(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+	auto is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letters, _mm256_set1_epi8(25)), letters);
+	return _mm256_or_si256(is_digit, is_letter);
+}
+
+JC_TARGET_AVX2 static WhitespaceRun SkipWhitespaceAvx2(const char* begin, const char* end)
+{
+	WhitespaceRun run{ 0, 0, 0 };
+	auto p = begin;
+	while (end - p >= 32)
+	{
+		auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		uint32_t spaces = (uint32_t)_mm256_movemask_epi8(SpaceMask256(bytes));
+		uint32_t newlines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')));
+		uint32_t length = std::countr_zero(~spaces);
+
+		CountRunNewlines(run, newlines, length, p - begin);
+		p += length;
+		if (length < 32)
+		{
+			run.length = p - begin;
+			return run;
+		}
+	}
+	return FinishWhitespaceRun(run, begin, p, end);
+}
+
+JC_TARGET_AVX2 static size_t IdentifierLengthAvx2(const char* begin, const char* end)
+{
+	auto p = begin;
+	while (end - p >= 32)
+	{
+		auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		uint32_t alnum = (uint32_t)_mm256_movemask_epi8(AlnumMask256(bytes));
+		uint32_t length = std::countr_zero(~alnum);
+		p += length;
+		if (length < 32)
+		{
+			return p - begin;
+		}
+	}
+	return (p - begin) + IdentifierLengthScalar(p, end);
+}
+
+JC_TARGET_AVX2 static const char* FindNewlineAvx2(const char* begin, const char* end)
+{
+	auto p = begin;
+	auto newline = _mm256_set1_epi8('\n');
+	while (end - p >= 32)
+	{
+		auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline));
+		if (mask)
+		{
+			return p + std::countr_zero(mask);
+		}
+		p += 32;
+	}
+	return FindNewlineSse2(p, end);
+}
+
+static bool CpuHasAvx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// the OS has to save the ymm registers too
+	__cpuid(info, 1);
+	bool osxsave = info[2] & (1 << 27);
+	bool avx = info[2] & (1 << 28);
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return info[1] & (1 << 5);
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+static const LexerKernels scalar_kernels = { "scalar", SkipWhitespaceScalar, IdentifierLengthScalar, FindNewlineScalar };
+#ifdef JC_LEXER_X64
+static const LexerKernels sse2_kernels = { "sse2", SkipWhitespaceSse2, IdentifierLengthSse2, FindNewlineSse2 };
+static const LexerKernels avx2_kernels = { "avx2", SkipWhitespaceAvx2, IdentifierLengthAvx2, FindNewlineAvx2 };
+#endif
+
+const LexerKernels* FindLexerKernels(const char* name)
+{
+	if (std::strcmp(name, "scalar") == 0)
+		return &scalar_kernels;
+#ifdef JC_LEXER_X64
+	if (std::strcmp(name, "sse2") == 0)
+		return &sse2_kernels;
+	if (std::strcmp(name, "avx2") == 0 && CpuHasAvx2())
+		return &avx2_kernels;
+#endif
+	return nullptr;
+}
+
+static const LexerKernels& SelectLexerKernels()
+{
+	const LexerKernels* best = &scalar_kernels;
+#ifdef JC_LEXER_X64
+	best = CpuHasAvx2() ? &avx2_kernels : &sse2_kernels;
+#endif
+
+	// lets the fast paths be compared against each other on the same machine
+#ifdef _WIN32
+	char* requested = nullptr;
+	size_t requested_size = 0;
+	_dupenv_s(&requested, &requested_size, "JC_LEXER_KERNELS");
+#else
+	const char* requested = std::getenv("JC_LEXER_KERNELS");
+#endif
+
+	if (auto found = requested ? FindLexerKernels(requested) : nullptr)
+	{
+		best = found;
+	}
+
+#ifdef _WIN32
+	std::free(requested);
+#endif
+
+	return *best;
+}
+
+const LexerKernels& GetLexerKernels()
+{
+	static const LexerKernels& kernels = SelectLexerKernels();
+	return kernels;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Bulk scanning routines used by the Lexer fast paths. Each routine has a scalar, an SSE2
+// and an AVX2 version, the best one supported by the CPU is picked once at startup.
+// All of them stop at `end` and never read past it.
+
+enum CharClass : uint8_t
+{
+	CHAR_SPACE = 1 << 0,
+	CHAR_ALPHA = 1 << 1,
+	CHAR_DIGIT = 1 << 2,
+};
+
+struct CharClassTable
+{
+	uint8_t values[256];
+};
+
+// same classification as std::isspace/isalpha/isdigit in the "C" locale, without the call
+constexpr CharClassTable MakeCharClassTable()
+{
+	CharClassTable table{};
+	for (int c = 0; c < 256; c++)
+	{
+		if (c == ' ' || (c >= '\t' && c <= '\r'))
+			table.values[c] |= CHAR_SPACE;
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+			table.values[c] |= CHAR_ALPHA;
+		if (c >= '0' && c <= '9')
+			table.values[c] |= CHAR_DIGIT;
+	}
+	return table;
+}
+
+inline constexpr CharClassTable char_classes = MakeCharClassTable();
+
+inline bool IsSpaceChar(char c) { return char_classes.values[(uint8_t)c] & CHAR_SPACE; }
+inline bool IsAlphaChar(char c) { return char_classes.values[(uint8_t)c] & CHAR_ALPHA; }
+inline bool IsDigitChar(char c) { return char_classes.values[(uint8_t)c] & CHAR_DIGIT; }
+inline bool IsAlnumChar(char c) { return char_classes.values[(uint8_t)c] & (CHAR_ALPHA | CHAR_DIGIT); }
+
+struct WhitespaceRun
+{
+	size_t length;
+	size_t newlines;
+	// index of the last '\n' inside the run, only meaningful when newlines != 0
+	size_t last_newline;
+};
+
+struct LexerKernels
+{
+	const char* name;
+	WhitespaceRun (*skip_whitespace)(const char* begin, const char* end);
+	size_t (*identifier_length)(const char* begin, const char* end);
+	const char* (*find_newline)(const char* begin, const char* end);
+};
+
+// the kernels selected for this CPU, JC_LEXER_KERNELS=scalar|sse2|avx2 overrides the choice
+const LexerKernels& GetLexerKernels();
+// the kernels called `name`, nullptr when this build or this CPU has none of that name
+const LexerKernels* FindLexerKernels(const char* name);
@@ -0,0 +1,569 @@
+#include "ModuleGraph.hpp"
+#include "CodeGen.hpp"
+#include "OutputBuffer.hpp"
+#include "Utils.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+
+std::unique_lock<std::mutex> ModuleLocks::Lock(const std::filesystem::path& source)
+{
+	std::error_code error;
+	auto key = std::filesystem::weakly_canonical(source, error).string();
+	if (error)
+	{
+		key = source.lexically_normal().string();
+	}
+
+	std::mutex* lock;
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		auto& found = locks[key];
+		if (!found)
+		{
+			found = std::make_unique<std::mutex>();
+		}
+		lock = found.get();
+	}
+	return std::unique_lock<std::mutex>(*lock);
+}
+
+ModuleGraph::ModuleGraph(Context* root, ModuleLocks* locks)
+	: root(root)
+	, locks(locks)
+	, thread_count(root->thread_count)
+	, print_timing(root->print_timing)
+	, root_output_path(root->output_path ? root->output_path : "")
+{
+}
+
+void ModuleGraph::Build()
+{
+	root->ScanImports();
+	if (root->import_paths.empty())
+	{
+		auto lock = LockOutputs(root->file_path);
+		root->Compile();
+		return;
+	}
+
+	auto build_start = get_time();
+	AddModule(root->file_path, root);
+	Discover();
+	if (!Sort())
+	{
+		return;
+	}
+
+	// whether the interface of a stale module changes is only known once it is built, its
+	// importers are checked again then
+	for (auto module : order)
+	{
+		module->stale = IsStale(module);
+		for (auto imported : module->imports)
+		{
+			module->stale |= imported->stale;
+		}
+	}
+
+	// a module that is compiled needs the declarations of everything it imports, and
+	// those need the declarations of their imports in turn
+	for (auto it = order.rbegin(); it != order.rend(); ++it)
+	{
+		if ((*it)->stale || (*it)->needed)
+		{
+			for (auto imported : (*it)->imports)
+			{
+				imported->needed = !imported->stale;
+			}
+		}
+	}
+
+	Schedule();
+
+	auto build_time = get_time_diff_ms(build_start);
+	if (print_timing)
+	{
+		size_t compiled = 0;
+		size_t parsed = 0;
+		for (auto module : order)
+		{
+			compiled += module->stale;
+			parsed += module->needed;
+		}
+		std::cout << "Module Build Took: " << build_time << "ms (" << modules.size() << " modules, " << compiled
+			<< " compiled, " << parsed << " declarations only, " << modules.size() - compiled - parsed << " skipped)" << std::endl;
+	}
+}
+
+void ModuleGraph::PrintMessages(std::ostream& out)
+{
+	if (modules.empty())
+	{
+		root->PrintMessages(out);
+		return;
+	}
+
+	for (auto& module : modules)
+	{
+		auto context = module->context;
+		if (!context->errors.empty() || (context->print_warings && !context->warnings.empty()))
+		{
+			out << "In " << module->path.string() << ":" << std::endl;
+			context->PrintMessages(out);
+		}
+	}
+}
+
+bool ModuleGraph::HasErrors() const
+{
+	if (!root->errors.empty())
+	{
+		return true;
+	}
+
+	for (auto& module : modules)
+	{
+		if (!module->context->errors.empty())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+ModuleGraph::Module* ModuleGraph::AddModule(const std::filesystem::path& path, Context* context)
+{
+	std::error_code error;
+	auto key = std::filesystem::weakly_canonical(path, error).string();
+	if (error)
+	{
+		key = path.lexically_normal().string();
+	}
+
+	if (auto found = by_path.find(key); found != by_path.end())
+	{
+		return found->second;
+	}
+
+	auto module = std::make_unique<Module>();
+	module->path = path.lexically_normal();
+	if (context)
+	{
+		module->context = context;
+	}
+	else
+	{
+		module->owned = std::make_unique<Context>(module->path.string().c_str());
+		module->context = module->owned.get();
+		module->context->print_warings = root->print_warings;
+		module->context->fused_semantics = root->fused_semantics;
+		module->context->cache_path = root->cache_path;
+	}
+
+	// modules run next to each other on the graph's pool instead of each starting its own
+	module->context->thread_count = 1;
+	module->context->print_timing = false;
+
+	auto result = module.get();
+	by_path.emplace(std::move(key), result);
+	modules.push_back(std::move(module));
+	return result;
+}
+
+void ModuleGraph::Discover()
+{
+	// modules grows while it is walked, every module added is scanned in turn
+	for (size_t i = 0; i < modules.size(); ++i)
+	{
+		auto module = modules[i].get();
+		// an interface written since the source last changed has its imports, and the
+		// module is not lexed at all when it turns out to be up to date
+		if (module->context != root && OpenInterface(module))
+		{
+			module->context->import_paths.clear();
+			for (const auto& import_path : module->interface.Header().imports)
+			{
+				module->context->import_paths.emplace_back(import_path.View());
+			}
+		}
+		else
+		{
+			module->context->ScanImports();
+		}
+		for (const auto& import_path : module->context->import_paths)
+		{
+			auto imported = AddModule(module->path.parent_path() / import_path, nullptr);
+			module->imports.push_back(imported);
+			imported->dependents.push_back(module);
+		}
+	}
+}
+
+bool ModuleGraph::OpenInterface(Module* module)
+{
+	// the .jmi keeps its time while its declarations do, the .d is written by every build
+	std::error_code error;
+	auto build_time = std::filesystem::last_write_time(std::filesystem::path(module->path).replace_extension(".d"), error);
+	if (error)
+	{
+		return false;
+	}
+	auto source_time = std::filesystem::last_write_time(module->path, error);
+	if (error || source_time > build_time)
+	{
+		return false;
+	}
+	auto interface_path = std::filesystem::path(module->path).replace_extension(".jmi");
+	return module->interface.Open(interface_path.string().c_str());
+}
+
+bool ModuleGraph::Sort()
+{
+	std::vector<Module*> ready;
+	for (auto& module : modules)
+	{
+		module->waiting = module->imports.size();
+		if (module->waiting == 0)
+		{
+			ready.push_back(module.get());
+		}
+	}
+
+	while (!ready.empty())
+	{
+		auto module = ready.back();
+		ready.pop_back();
+		order.push_back(module);
+		for (auto dependent : module->dependents)
+		{
+			if (--dependent->waiting == 0)
+			{
+				ready.push_back(dependent);
+			}
+		}
+	}
+
+	if (order.size() == modules.size())
+	{
+		return true;
+	}
+
+	// a module left waiting imports at least one other that is, so following those imports
+	// comes back around. Modules that only import the cycle are left out of the message
+	Module* start = nullptr;
+	for (auto& module : modules)
+	{
+		if (module->waiting > 0)
+		{
+			start = module.get();
+			break;
+		}
+	}
+
+	std::vector<Module*> path;
+	std::unordered_map<Module*, size_t> position;
+	auto module = start;
+	while (position.find(module) == position.end())
+	{
+		position.emplace(module, path.size());
+		path.push_back(module);
+		for (auto imported : module->imports)
+		{
+			if (imported->waiting > 0)
+			{
+				module = imported;
+				break;
+			}
+		}
+	}
+
+	std::string cycle;
+	for (auto i = position[module]; i < path.size(); ++i)
+	{
+		cycle += path[i]->path.string() + " imports ";
+	}
+	cycle += module->path.string();
+	root->Error("Modules import each other: " + cycle, 0, 0);
+	return false;
+}
+
+bool ModuleGraph::IsStale(Module* module)
+{
+	std::error_code error;
+	auto header_path = std::filesystem::path(module->path).replace_extension(".hpp");
+	auto interface_path = std::filesystem::path(module->path).replace_extension(".jmi");
+	if (!std::filesystem::exists(header_path, error) || !std::filesystem::exists(interface_path, error))
+	{
+		return true;
+	}
+
+	// the .jmi can be older than the build that last wrote it, the .cpp and .d never are
+	std::filesystem::file_time_type oldest_output = std::filesystem::file_time_type::max();
+	for (auto output : { OutputPath(module), std::filesystem::path(module->path).replace_extension(".d") })
+	{
+		auto time = std::filesystem::last_write_time(output, error);
+		if (error)
+		{
+			return true;
+		}
+		oldest_output = std::min(oldest_output, time);
+	}
+
+	// "<outputs>: <source> <interface> <interface>...", a space in a path is escaped with a backslash
+	std::ifstream file(std::filesystem::path(module->path).replace_extension(".d"));
+	std::stringstream contents;
+	contents << file.rdbuf();
+	auto text = contents.str();
+	auto colon = text.find(": ");
+	if (colon == std::string::npos)
+	{
+		return true;
+	}
+
+	std::string source;
+	size_t source_count = 0;
+	for (size_t i = colon + 2; i <= text.size(); ++i)
+	{
+		if (i < text.size() && text[i] == '\\' && i + 1 < text.size() && text[i + 1] == ' ')
+		{
+			source += ' ';
+			++i;
+		}
+		else if (i == text.size() || text[i] == ' ' || text[i] == '\n' || text[i] == '\r')
+		{
+			if (!source.empty())
+			{
+				auto time = std::filesystem::last_write_time(source, error);
+				if (error || time > oldest_output)
+				{
+					return true;
+				}
+				source_count++;
+				source.clear();
+			}
+		}
+		else
+		{
+			source += text[i];
+		}
+	}
+
+	return source_count == 0;
+}
+
+void ModuleGraph::Schedule()
+{
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<Module*> ready;
+	size_t remaining = 0;
+
+	for (auto module : order)
+	{
+		if (!module->stale && !module->needed)
+		{
+			continue;
+		}
+
+		remaining++;
+		module->waiting = 0;
+		for (auto imported : module->imports)
+		{
+			module->waiting += imported->stale || imported->needed;
+		}
+		if (module->waiting == 0)
+		{
+			ready.push_back(module);
+		}
+	}
+
+	ThreadPool pool(thread_count);
+	pool.ParallelFor(pool.ThreadCount(), [&](size_t)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			changed.wait(lock, [&] { return !ready.empty() || remaining == 0; });
+			if (remaining == 0)
+			{
+				return;
+			}
+
+			auto module = ready.back();
+			ready.pop_back();
+			lock.unlock();
+			BuildModule(module);
+			lock.lock();
+
+			remaining--;
+			for (auto dependent : module->dependents)
+			{
+				if ((dependent->stale || dependent->needed) && --dependent->waiting == 0)
+				{
+					ready.push_back(dependent);
+				}
+			}
+			changed.notify_all();
+		}
+	});
+}
+
+void ModuleGraph::BuildModule(Module* module)
+{
+	auto context = module->context;
+	for (auto imported : module->imports)
+	{
+		if (imported->failed)
+		{
+			module->failed = true;
+			context->Error("Not compiling because " + imported->path.string() + " has errors", 0, 0);
+			return;
+		}
+	}
+
+	// an interface only has what its module declares, what that module imported comes
+	// from the interfaces further down
+	for (auto imported : Imported(module))
+	{
+		context->imports.push_back(&imported->interface);
+	}
+
+	// the interfaces of its imports are written now, they may have stayed the same. Or
+	// another graph built the module since it was found stale, then its outputs are
+	// current and its interface is the one that graph wrote
+	std::unique_lock<std::mutex> lock;
+	if (module->stale)
+	{
+		lock = LockOutputs(module->path);
+		if (!IsStale(module))
+		{
+			module->stale = false;
+			OpenInterface(module);
+		}
+	}
+
+	if (module->stale)
+	{
+		auto output_path = OutputPath(module).string();
+		context->output_path = output_path.c_str();
+		context->Compile();
+		context->output_path = nullptr;
+	}
+	else if (!module->interface.IsLoaded())
+	{
+		// the .jmi went missing or is from another version, the source still has the declarations
+		context->ParseSignatures();
+	}
+
+	module->failed = !context->errors.empty();
+	if (!module->failed && (module->stale || !module->interface.IsLoaded()))
+	{
+		module->interface.Build(*context);
+	}
+	if (module->stale && !module->failed)
+	{
+		WriteOutputs(module);
+	}
+}
+
+std::unique_lock<std::mutex> ModuleGraph::LockOutputs(const std::filesystem::path& source)
+{
+	return locks ? locks->Lock(source) : std::unique_lock<std::mutex>();
+}
+
+std::filesystem::path ModuleGraph::OutputPath(Module* module) const
+{
+	if (module->context == root && !root_output_path.empty())
+	{
+		return root_output_path;
+	}
+	return std::filesystem::path(module->path).replace_extension(".cpp");
+}
+
+std::vector<ModuleGraph::Module*> ModuleGraph::Imported(Module* module)
+{
+	// nearest first, each module once
+	std::vector<Module*> imported;
+	std::unordered_set<Module*> seen{ module };
+	auto visit = [&](Module* from)
+	{
+		for (auto next : from->imports)
+		{
+			if (seen.insert(next).second)
+			{
+				imported.push_back(next);
+			}
+		}
+	};
+	visit(module);
+	for (size_t i = 0; i < imported.size(); ++i)
+	{
+		visit(imported[i]);
+	}
+	return imported;
+}
+
+void ModuleGraph::WriteOutputs(Module* module)
+{
+	auto context = module->context;
+	OutputBuffer header;
+	CodeGen codegen(context);
+	codegen.GenerateHeader(header);
+	auto header_path = std::filesystem::path(module->path).replace_extension(".hpp");
+	if (!header.WriteToFile(header_path.string().c_str()))
+	{
+		context->Error("Could not write " + header_path.string(), 0, 0);
+		return;
+	}
+
+	auto interface_path = std::filesystem::path(module->path).replace_extension(".jmi");
+	if (!module->interface.Write(interface_path.string().c_str()))
+	{
+		context->Error("Could not write " + interface_path.string(), 0, 0);
+		return;
+	}
+
+	// everything the module was built from, its own source and the interface of every
+	// module it sees. Their sources are not listed, only a change to what they declare
+	// makes this module stale
+	std::vector<std::filesystem::path> sources{ module->path };
+	for (auto imported : Imported(module))
+	{
+		sources.push_back(std::filesystem::path(imported->path).replace_extension(".jmi"));
+	}
+
+	auto escape = [](const std::filesystem::path& path)
+	{
+		std::string escaped;
+		for (auto c : path.generic_string())
+		{
+			if (c == ' ')
+			{
+				escaped += '\\';
+			}
+			escaped += c;
+		}
+		return escaped;
+	};
+
+	// written last, an interrupted build leaves the module stale
+	OutputBuffer dependencies;
+	dependencies << escape(OutputPath(module)) << " "
+		<< escape(header_path) << ":";
+	for (auto source : sources)
+	{
+		dependencies << " " << escape(source);
+	}
+	dependencies << "\n";
+
+	auto dependency_path = std::filesystem::path(module->path).replace_extension(".d");
+	if (!dependencies.WriteToFile(dependency_path.string().c_str()))
+	{
+		context->Error("Could not write " + dependency_path.string(), 0, 0);
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "Context.hpp"
+#include "ModuleInterface.hpp"
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// One lock per source, shared by the graphs of a batch. Two files of a batch can import the
+// same module, or be the same file, and its outputs must be built by one of them at a time
+class ModuleLocks
+{
+public:
+	std::unique_lock<std::mutex> Lock(const std::filesystem::path& source);
+
+private:
+	std::mutex mutex;
+	std::unordered_map<std::string, std::unique_ptr<std::mutex>> locks;
+};
+
+// The files a program is made of, one Context per file, linked by their `import`s.
+// A file without imports is compiled on its own as before. Otherwise every module gets
+// <name>.cpp, a <name>.hpp with its structs and function declarations for the modules
+// importing it, a <name>.jmi with the same declarations as a ModuleInterface, and a
+// <name>.d in make syntax listing its source and the .jmi of every module it sees.
+// Modules are compiled on a pool, each one once everything it imports is done, so
+// modules that do not depend on each other compile at the same time. A module whose
+// .cpp and .d are newer than everything in its .d is not compiled again, if something
+// importing it is, its .jmi is mapped and the module is neither lexed nor parsed.
+// A .jmi is only rewritten when the declarations in it change, so editing the body of
+// a function compiles that module again but not the ones importing it.
+class ModuleGraph
+{
+public:
+	// `root` is the file given on the command line, its options are used for every module.
+	// `locks` is given when other graphs may build the same modules at the same time
+	explicit ModuleGraph(Context* root, ModuleLocks* locks = nullptr);
+
+	void Build();
+	void PrintMessages(std::ostream& out = std::cout);
+	// errors in the root or any module it imports
+	bool HasErrors() const;
+
+private:
+	struct Module
+	{
+		Context* context = nullptr;
+		std::unique_ptr<Context> owned;
+		std::filesystem::path path;
+		// what importers see, from its .jmi or built once it is compiled
+		ModuleInterface interface;
+		std::vector<Module*> imports;
+		std::vector<Module*> dependents;
+		// an output is missing or older than one of the files it was built from. Until its
+		// imports are built, also set when one of them is, their interfaces may change
+		bool stale = false;
+		// up to date, but something stale imports it and needs its declarations
+		bool needed = false;
+		// it or a module it imports has errors, so nothing is generated for it
+		bool failed = false;
+		// imports that still have to be compiled or parsed before this one can start
+		size_t waiting = 0;
+	};
+
+	Module* AddModule(const std::filesystem::path& path, Context* context);
+	void Discover();
+	// maps the .jmi of a module built since its source last changed
+	bool OpenInterface(Module* module);
+	// every module after the ones it imports, false when the imports form a cycle
+	bool Sort();
+	bool IsStale(Module* module);
+	void Schedule();
+	void BuildModule(Module* module);
+	// every module `module` sees, the ones it imports and the ones those import in turn
+	std::vector<Module*> Imported(Module* module);
+	void WriteOutputs(Module* module);
+	// where the generated code of `module` goes, -o for the root and <name>.cpp otherwise
+	std::filesystem::path OutputPath(Module* module) const;
+	// held while the outputs of `source` are written, nothing to hold without other graphs
+	std::unique_lock<std::mutex> LockOutputs(const std::filesystem::path& source);
+
+	Context* root;
+	ModuleLocks* locks;
+	// the root's options, every module compiles on a single thread and prints no timing
+	size_t thread_count;
+	bool print_timing;
+	// of the root, empty when it goes next to its source like every other module's
+	std::string root_output_path;
+	std::vector<std::unique_ptr<Module>> modules;
+	// keyed by the canonical path, so a file imported along several paths is one module
+	std::unordered_map<std::string, Module*> by_path;
+	std::vector<Module*> order;
+};
@@ -0,0 +1,264 @@
+#include "ModuleInterface.hpp"
+#include "Context.hpp"
+#include "OutputBuffer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+constexpr char MODULE_INTERFACE_MAGIC[4] = { 'j', 'm', 'i', '\0' };
+
+// lays an interface out front to back, references are patched in once their target has a place
+class InterfaceBuilder
+{
+public:
+	explicit InterfaceBuilder(std::vector<uint32_t>& words)
+		: words(words)
+	{
+		words.clear();
+	}
+
+	// room for `size` bytes, zeroed and rounded up to the alignment, returns its offset
+	uint32_t Reserve(size_t size)
+	{
+		auto at = Size();
+		words.resize(words.size() + (size + 3) / 4, 0);
+		return at;
+	}
+
+	uint32_t Size() const { return (uint32_t)(words.size() * 4); }
+
+	template<typename T>
+	T& At(uint32_t at)
+	{
+		return *reinterpret_cast<T*>(reinterpret_cast<char*>(words.data()) + at);
+	}
+
+	// the reference at offset `at` is to `count` things starting at `target`
+	void Link(uint32_t at, uint32_t target, uint32_t count)
+	{
+		At<int32_t>(at) = (int32_t)target - (int32_t)at;
+		At<uint32_t>(at + 4) = count;
+	}
+
+	// the same text is stored once, names like "x" come up in many places
+	void String(uint32_t at, std::string_view text)
+	{
+		auto found = strings.find(text);
+		uint32_t target;
+		if (found != strings.end())
+		{
+			target = found->second;
+		}
+		else
+		{
+			target = Reserve(text.size());
+			std::memcpy(&At<char>(target), text.data(), text.size());
+			strings.emplace(text, target);
+		}
+		Link(at, target, (uint32_t)text.size());
+	}
+
+private:
+	std::vector<uint32_t>& words;
+	std::unordered_map<std::string_view, uint32_t> strings;
+};
+
+void ModuleInterface::Build(const Context& module)
+{
+	file.Close();
+	header = nullptr;
+
+	// struct types get their index among the structs, the rest keep their TypeID
+	std::vector<const StructDefination*> structs;
+	std::vector<uint32_t> type_codes(module.types.Count(), TYPE_UNKNOWN);
+	for (uint32_t id = 0; id < module.types.Count(); ++id)
+	{
+		if (id < PRIMITIVE_TYPE_COUNT)
+		{
+			type_codes[id] = id;
+		}
+		else if (auto defination = module.structs.Get(module.types.Symbol(Type{ (TypeID)id })))
+		{
+			type_codes[id] = (uint32_t)(PRIMITIVE_TYPE_COUNT + structs.size());
+			structs.push_back(defination);
+		}
+	}
+	auto type_code = [&](Type type) { return type.id < type_codes.size() ? type_codes[type.id] : (uint32_t)TYPE_UNKNOWN; };
+
+	std::vector<const FunctionPrototype*> functions;
+	if (module.program)
+	{
+		for (auto statement : module.program->statements)
+		{
+			if (statement->node_type == ASTNodeType::ExternFunctionStatement)
+			{
+				functions.push_back(static_cast<ExternFunctionStatement*>(statement)->prototype);
+			}
+		}
+		for (auto function : module.program->functions)
+		{
+			functions.push_back(function->prototype);
+		}
+	}
+
+	InterfaceBuilder builder(built);
+	auto header_at = builder.Reserve(sizeof(InterfaceHeader));
+	auto imports_at = builder.Reserve(module.import_paths.size() * sizeof(InterfaceString));
+	auto structs_at = builder.Reserve(structs.size() * sizeof(InterfaceStruct));
+	auto functions_at = builder.Reserve(functions.size() * sizeof(InterfacePrototype));
+	builder.Link(header_at + offsetof(InterfaceHeader, imports), imports_at, (uint32_t)module.import_paths.size());
+	builder.Link(header_at + offsetof(InterfaceHeader, structs), structs_at, (uint32_t)structs.size());
+	builder.Link(header_at + offsetof(InterfaceHeader, functions), functions_at, (uint32_t)functions.size());
+
+	for (size_t i = 0; i < module.import_paths.size(); ++i)
+	{
+		builder.String(imports_at + (uint32_t)(i * sizeof(InterfaceString)), module.import_paths[i]);
+	}
+
+	for (size_t i = 0; i < structs.size(); ++i)
+	{
+		auto at = structs_at + (uint32_t)(i * sizeof(InterfaceStruct));
+		auto& fields = structs[i]->fields;
+		auto fields_at = builder.Reserve(fields.size() * sizeof(InterfaceField));
+		builder.String(at + offsetof(InterfaceStruct, name), structs[i]->name);
+		builder.Link(at + offsetof(InterfaceStruct, fields), fields_at, (uint32_t)fields.size());
+		for (size_t j = 0; j < fields.size(); ++j)
+		{
+			auto field_at = fields_at + (uint32_t)(j * sizeof(InterfaceField));
+			builder.String(field_at + offsetof(InterfaceField, name), fields[j].name);
+			builder.At<uint32_t>(field_at + offsetof(InterfaceField, type)) = type_code(fields[j].data_type);
+		}
+	}
+
+	for (size_t i = 0; i < functions.size(); ++i)
+	{
+		auto at = functions_at + (uint32_t)(i * sizeof(InterfacePrototype));
+		auto& params = functions[i]->params;
+		auto params_at = builder.Reserve(params.size() * sizeof(InterfaceField));
+		builder.String(at + offsetof(InterfacePrototype, name), functions[i]->name);
+		builder.At<uint32_t>(at + offsetof(InterfacePrototype, return_type)) = type_code(functions[i]->return_type);
+		builder.Link(at + offsetof(InterfacePrototype, params), params_at, (uint32_t)params.size());
+		for (size_t j = 0; j < params.size(); ++j)
+		{
+			auto param_at = params_at + (uint32_t)(j * sizeof(InterfaceField));
+			builder.String(param_at + offsetof(InterfaceField, name), params[j].name);
+			builder.At<uint32_t>(param_at + offsetof(InterfaceField, type)) = type_code(params[j].data_type);
+		}
+	}
+
+	auto& result = builder.At<InterfaceHeader>(header_at);
+	std::memcpy(result.magic, MODULE_INTERFACE_MAGIC, sizeof(result.magic));
+	result.version = MODULE_INTERFACE_VERSION;
+	result.size = builder.Size();
+	header = &result;
+}
+
+bool ModuleInterface::Open(const char* path)
+{
+	built.clear();
+	header = nullptr;
+	if (!file.Open(path))
+	{
+		return false;
+	}
+
+	auto data = file.View();
+	// a mapping starts on a page and a read buffer comes from the allocator, both aligned
+	if (data.size() < sizeof(InterfaceHeader) || (uintptr_t)data.data() % alignof(InterfaceHeader) != 0)
+	{
+		file.Close();
+		return false;
+	}
+
+	header = reinterpret_cast<const InterfaceHeader*>(data.data());
+	if (std::memcmp(header->magic, MODULE_INTERFACE_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != MODULE_INTERFACE_VERSION || header->size != data.size() || !Validate(data.size()))
+	{
+		header = nullptr;
+		file.Close();
+		return false;
+	}
+	return true;
+}
+
+bool ModuleInterface::Write(const char* path) const
+{
+	// the file keeps its time while what it declares stays the same, that time is what
+	// the modules importing it compare against
+	auto bytes = std::string_view(reinterpret_cast<const char*>(built.data()), header->size);
+	SourceBuffer existing;
+	if (existing.Open(path) && existing.View() == bytes)
+	{
+		return true;
+	}
+	existing.Close();
+
+	OutputBuffer out;
+	out.Append(reinterpret_cast<const char*>(built.data()), header->size);
+	return out.WriteToFile(path);
+}
+
+bool ModuleInterface::Validate(size_t size) const
+{
+	// one pass over the references, nothing is copied, so a file that does not pass is never used
+	auto base = reinterpret_cast<const char*>(header);
+	auto inside = [&](const void* field, size_t element_size, size_t count)
+	{
+		auto begin = (reinterpret_cast<const char*>(field) - base) + (ptrdiff_t)*reinterpret_cast<const int32_t*>(field);
+		return begin >= 0 && begin % 4 == 0 && (size_t)begin <= size &&
+			count <= (size - (size_t)begin) / std::max<size_t>(element_size, 1);
+	};
+	auto valid_string = [&](const InterfaceString& string)
+	{
+		return inside(&string, 1, string.size);
+	};
+	auto valid_type = [&](uint32_t type)
+	{
+		return !IsStructType(type) || StructIndex(type) < header->structs.size();
+	};
+	auto valid_fields = [&](const InterfaceArray<InterfaceField>& fields)
+	{
+		if (!inside(&fields, sizeof(InterfaceField), fields.size()))
+		{
+			return false;
+		}
+		for (auto& field : fields)
+		{
+			if (!valid_string(field.name) || !valid_type(field.type))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	if (!inside(&header->imports, sizeof(InterfaceString), header->imports.size()) ||
+		!inside(&header->structs, sizeof(InterfaceStruct), header->structs.size()) ||
+		!inside(&header->functions, sizeof(InterfacePrototype), header->functions.size()))
+	{
+		return false;
+	}
+
+	for (auto& import : header->imports)
+	{
+		if (!valid_string(import))
+		{
+			return false;
+		}
+	}
+	for (auto& defination : header->structs)
+	{
+		if (!valid_string(defination.name) || !valid_fields(defination.fields))
+		{
+			return false;
+		}
+	}
+	for (auto& prototype : header->functions)
+	{
+		if (!valid_string(prototype.name) || !valid_type(prototype.return_type) || !valid_fields(prototype.params))
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "SourceBuffer.hpp"
+#include "Type.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+struct Context;
+
+// bumped whenever the layout below changes, a file of another version is not used
+constexpr uint32_t MODULE_INTERFACE_VERSION = 1;
+
+// The layout of a module interface. A reference is an offset from the field that holds
+// it, so a mapped file is used where it lies, with nothing to fix up and nothing read
+// before it is asked for. Every field is 32 bits, so the layout is the same for every
+// compiler and only asks for 4 byte alignment. A type is a primitive TypeID, or past
+// TYPE_VOID the index of a struct of the same interface.
+
+// `count` elements starting `offset` bytes from the array itself, text that is stored
+// once for several names can be before it
+template<typename T>
+struct InterfaceArray
+{
+	int32_t offset;
+	uint32_t count;
+
+	// a copy would point somewhere else, arrays are only used where they are stored
+	InterfaceArray(const InterfaceArray&) = delete;
+	InterfaceArray& operator=(const InterfaceArray&) = delete;
+
+	const T* begin() const { return reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) + offset); }
+	const T* end() const { return begin() + count; }
+	const T& operator[](size_t index) const { return begin()[index]; }
+	size_t size() const { return count; }
+};
+
+struct InterfaceString
+{
+	int32_t offset;
+	uint32_t size;
+
+	InterfaceString(const InterfaceString&) = delete;
+	InterfaceString& operator=(const InterfaceString&) = delete;
+
+	std::string_view View() const { return std::string_view(reinterpret_cast<const char*>(this) + offset, size); }
+};
+
+// a struct field or a parameter
+struct InterfaceField
+{
+	InterfaceString name;
+	uint32_t type;
+};
+
+struct InterfaceStruct
+{
+	InterfaceString name;
+	InterfaceArray<InterfaceField> fields;
+};
+
+struct InterfacePrototype
+{
+	InterfaceString name;
+	uint32_t return_type;
+	InterfaceArray<InterfaceField> params;
+};
+
+struct InterfaceHeader
+{
+	char magic[4];
+	uint32_t version;
+	// of the whole interface, header included
+	uint32_t size;
+	// as written in the module's `import` declarations
+	InterfaceArray<InterfaceString> imports;
+	InterfaceArray<InterfaceStruct> structs;
+	InterfaceArray<InterfacePrototype> functions;
+};
+
+// The declarations a module exports, which is everything a module importing it needs.
+// It is built from a parsed module and written next to the module's outputs, a later
+// build maps that file instead of lexing and parsing the module again.
+class ModuleInterface
+{
+public:
+	// every struct `module` knows, so whatever a prototype names is in the same interface,
+	// and the functions it declares itself. The ones it imported are in the interfaces of
+	// its imports, which the modules importing this one are given as well
+	void Build(const Context& module);
+	// maps an interface Write wrote, false when it is missing, damaged or of another version
+	bool Open(const char* path);
+	// leaves the file alone when it already holds this interface
+	bool Write(const char* path) const;
+
+	bool IsLoaded() const { return header != nullptr; }
+	const InterfaceHeader& Header() const { return *header; }
+
+	static bool IsStructType(uint32_t type) { return type >= PRIMITIVE_TYPE_COUNT; }
+	static size_t StructIndex(uint32_t type) { return type - PRIMITIVE_TYPE_COUNT; }
+
+private:
+	// every offset stays inside the interface and every type names something in it
+	bool Validate(size_t size) const;
+
+	// an interface that was built, uint32_t so it is aligned like a mapped one
+	std::vector<uint32_t> built;
+	SourceBuffer file;
+	const InterfaceHeader* header = nullptr;
+};
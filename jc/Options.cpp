@@ -0,0 +1,57 @@
+#include "Options.hpp"
+#include <cstring>
+#include <cstdlib>
+
+void Options::Parse(const std::vector<const char*>& args)
+{
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		if (std::strcmp(args[i], "--stream") == 0)
+			stream_tokens = true;
+		else if (std::strcmp(args[i], "--pipeline") == 0)
+			pipeline = stream_tokens = true;
+		else if (std::strcmp(args[i], "--lazy") == 0)
+			lazy_bodies = true;
+		else if (std::strcmp(args[i], "--signatures") == 0)
+			signatures_only = lazy_bodies = true;
+		else if (std::strcmp(args[i], "--two-pass") == 0)
+			fused_semantics = false;
+		else if (std::strcmp(args[i], "-j") == 0 && i + 1 < args.size())
+			thread_count = std::strtoul(args[++i], nullptr, 10);
+		else if (std::strcmp(args[i], "-o") == 0 && i + 1 < args.size())
+			output_path = args[++i];
+		else if (std::strcmp(args[i], "--cache") == 0 && i + 1 < args.size())
+			cache_path = args[++i];
+		else
+			file_paths.push_back(args[i]);
+	}
+
+	if (file_paths.empty())
+	{
+		file_paths.push_back("test.jin");
+	}
+}
+
+void Options::Configure(Context* context) const
+{
+	context->print_timing = print_timing;
+	context->stream_tokens = stream_tokens;
+	context->thread_count = thread_count;
+	context->lazy_bodies = lazy_bodies;
+	context->signatures_only = signatures_only;
+	context->fused_semantics = fused_semantics;
+	context->pipeline = pipeline;
+	context->cache_path = cache_path;
+}
+
+std::string Options::Key() const
+{
+	// the thread count, timing and the cache change how long a compile takes, not what it gives
+	std::string key;
+	key += stream_tokens ? 's' : '-';
+	key += pipeline ? 'p' : '-';
+	key += lazy_bodies ? 'l' : '-';
+	key += signatures_only ? 'd' : '-';
+	key += fused_semantics ? 'f' : '-';
+	return key;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "Context.hpp"
+#include <string>
+#include <vector>
+
+// What the command line asks for, read the same way by main and by a daemon serving a
+// client that was started with it
+struct Options
+{
+	std::vector<const char*> file_paths;
+	bool stream_tokens = false;
+	size_t thread_count = 0;
+	bool lazy_bodies = false;
+	bool signatures_only = false;
+	bool fused_semantics = true;
+	const char* output_path = nullptr;
+	const char* cache_path = nullptr;
+	bool pipeline = false;
+	bool print_timing = true;
+
+	// the arguments point into `args`, which has to outlive the options
+	void Parse(const std::vector<const char*>& args);
+	// everything but the output path, that is up to whoever compiles the file
+	void Configure(Context* context) const;
+	// the options that change what a compile produces, two compiles with the same key
+	// and the same source give the same result
+	std::string Key() const;
+};
@@ -0,0 +1,305 @@
+#include "OutputBuffer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <filesystem>
+#include <random>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+OutputBuffer::OutputBuffer(int flush_fd)
+	: flush_fd(flush_fd)
+{
+	Chunk chunk;
+	chunk.data = std::make_unique<char[]>(CHUNK_SIZE);
+	chunk.capacity = CHUNK_SIZE;
+	cursor = chunk.data.get();
+	limit = cursor + CHUNK_SIZE;
+	chunks.push_back(std::move(chunk));
+}
+
+void OutputBuffer::Clear()
+{
+	chunks.resize(1);
+	cursor = chunks[0].data.get();
+	limit = cursor + chunks[0].capacity;
+	written = 0;
+	flushed = 0;
+}
+
+void OutputBuffer::AppendSlow(const char* text, size_t size)
+{
+	auto room = (size_t)(limit - cursor);
+	std::memcpy(cursor, text, room);
+	cursor += room;
+	NextChunk(size - room);
+	std::memcpy(cursor, text + room, size - room);
+	cursor += size - room;
+}
+
+void OutputBuffer::NextChunk(size_t min_size)
+{
+	auto& current = chunks.back();
+	current.size = (size_t)(cursor - current.data.get());
+	written += current.size;
+
+	if (flush_fd >= 0)
+	{
+		// the held text goes out and the first chunk is filled again
+		write_failed |= !WriteTo(flush_fd);
+		chunks.resize(1);
+		flushed = written;
+		if (chunks[0].capacity >= min_size)
+		{
+			cursor = chunks[0].data.get();
+			limit = cursor + chunks[0].capacity;
+			return;
+		}
+		chunks.clear();
+	}
+
+	// only a single append bigger than a chunk gets a chunk of its own size
+	Chunk chunk;
+	chunk.capacity = std::max(CHUNK_SIZE, min_size);
+	chunk.data = std::make_unique<char[]>(chunk.capacity);
+	cursor = chunk.data.get();
+	limit = cursor + chunk.capacity;
+	chunks.push_back(std::move(chunk));
+}
+
+size_t OutputBuffer::ChunkSize(size_t index) const
+{
+	if (index + 1 == chunks.size())
+	{
+		return (size_t)(cursor - chunks[index].data.get());
+	}
+	return chunks[index].size;
+}
+
+void OutputBuffer::AppendRange(const OutputBuffer& from, size_t begin, size_t end)
+{
+	assert(begin >= from.flushed && begin <= end && end <= from.Size());
+	begin -= from.flushed;
+	end -= from.flushed;
+
+	size_t chunk_begin = 0;
+	for (size_t i = 0; i < from.chunks.size() && chunk_begin < end; ++i)
+	{
+		auto size = from.ChunkSize(i);
+		auto chunk_end = chunk_begin + size;
+		if (chunk_end > begin)
+		{
+			auto first = std::max(begin, chunk_begin);
+			auto last = std::min(end, chunk_end);
+			Append(from.chunks[i].data.get() + (first - chunk_begin), last - first);
+		}
+		chunk_begin = chunk_end;
+	}
+}
+
+bool OutputBuffer::WriteToFile(const char* path) const
+{
+	// a file mapped by another compile keeps what it had, truncating it there would take
+	// the pages from under that mapping
+	auto temporary = std::string(path) + "." + std::to_string(std::random_device{}());
+	std::error_code error;
+	if (!WriteMapped(temporary.c_str()))
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+
+	std::filesystem::rename(temporary, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+bool OutputBuffer::Flush()
+{
+	if (flush_fd < 0)
+	{
+		return false;
+	}
+
+	auto total = Size();
+	write_failed |= !WriteTo(flush_fd);
+	Clear();
+	written = flushed = total;
+	return !write_failed;
+}
+
+#ifdef _WIN32
+
+bool OutputBuffer::WriteTo(int fd) const
+{
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		auto data = chunks[i].data.get();
+		auto size = ChunkSize(i);
+		while (size > 0)
+		{
+			auto count = _write(fd, data, (unsigned int)std::min<size_t>(size, INT_MAX));
+			if (count <= 0)
+			{
+				return false;
+			}
+			data += count;
+			size -= count;
+		}
+	}
+	return true;
+}
+
+bool OutputBuffer::WriteMapped(const char* path) const
+{
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	// an empty file cannot be mapped, and there is nothing to copy
+	assert(flushed == 0);
+	auto size = Size();
+	if (size == 0)
+	{
+		CloseHandle(file);
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+		(DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFF), nullptr);
+	CloseHandle(file);
+	if (!mapping)
+	{
+		return false;
+	}
+
+	auto view = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size));
+	if (!view)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		std::memcpy(view, chunks[i].data.get(), ChunkSize(i));
+		view += ChunkSize(i);
+	}
+
+	UnmapViewOfFile(view - size);
+	CloseHandle(mapping);
+	return true;
+}
+
+#else
+
+bool OutputBuffer::WriteTo(int fd) const
+{
+	// at most IOV_MAX chunks go out per call, the POSIX minimum for it is 16
+	constexpr size_t MAX_IOVECS = 16;
+	iovec iovecs[MAX_IOVECS];
+	size_t next = 0;
+	while (next < chunks.size())
+	{
+		size_t count = 0;
+		for (; count < MAX_IOVECS && next + count < chunks.size(); ++count)
+		{
+			iovecs[count].iov_base = chunks[next + count].data.get();
+			iovecs[count].iov_len = ChunkSize(next + count);
+		}
+		next += count;
+
+		// a short write leaves the rest of the batch for the next call
+		auto iov = iovecs;
+		while (count > 0)
+		{
+			auto result = writev(fd, iov, (int)count);
+			if (result < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+
+			auto done = (size_t)result;
+			while (count > 0 && done >= iov->iov_len)
+			{
+				done -= iov->iov_len;
+				++iov;
+				--count;
+			}
+			if (count > 0)
+			{
+				iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+				iov->iov_len -= done;
+			}
+		}
+	}
+	return true;
+}
+
+bool OutputBuffer::WriteMapped(const char* path) const
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	assert(flushed == 0);
+	auto size = Size();
+	if (size == 0)
+	{
+		close(fd);
+		return true;
+	}
+
+	if (ftruncate(fd, (off_t)size) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	auto view = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		// some file systems cannot map files, a plain write still works there
+		auto result = WriteTo(fd);
+		close(fd);
+		return result;
+	}
+
+	auto out = static_cast<char*>(view);
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		std::memcpy(out, chunks[i].data.get(), ChunkSize(i));
+		out += ChunkSize(i);
+	}
+
+	munmap(view, size);
+	close(fd);
+	return true;
+}
+
+#endif
@@ -0,0 +1,139 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+
+// Append only text buffer for generated code. Text goes into large chunks that never move
+// once written, so an append is a bounds check and a memcpy and numbers are formatted in
+// place with std::to_chars, there is no sentry, locale or virtual call per fragment.
+// The finished text is written to a file descriptor with writev, a batch of chunks per
+// call, or copied into a memory mapped output file. With a flush descriptor the chunks are
+// written out whenever one fills up, so only about one chunk of text is ever held.
+class OutputBuffer
+{
+public:
+	static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+	static constexpr int STANDARD_OUTPUT = 1;
+
+	// -1 keeps all the text until it is written out explicitly
+	explicit OutputBuffer(int flush_fd = -1);
+
+	OutputBuffer(const OutputBuffer&) = delete;
+	OutputBuffer& operator=(const OutputBuffer&) = delete;
+	OutputBuffer(OutputBuffer&&) = default;
+	OutputBuffer& operator=(OutputBuffer&&) = default;
+
+	void Append(const char* text, size_t size)
+	{
+		if ((size_t)(limit - cursor) < size)
+		{
+			AppendSlow(text, size);
+			return;
+		}
+		std::memcpy(cursor, text, size);
+		cursor += size;
+	}
+
+	OutputBuffer& operator<<(std::string_view text)
+	{
+		Append(text.data(), text.size());
+		return *this;
+	}
+
+	OutputBuffer& operator<<(const char* text)
+	{
+		return *this << std::string_view(text);
+	}
+
+	OutputBuffer& operator<<(char c)
+	{
+		if (cursor == limit)
+		{
+			NextChunk(1);
+		}
+		*cursor++ = c;
+		return *this;
+	}
+
+	template<typename T> requires std::is_integral_v<T>
+	OutputBuffer& operator<<(T value)
+	{
+		// enough for any 64 bit integer with its sign
+		auto first = Reserve(24);
+		cursor = std::to_chars(first, limit, value).ptr;
+		return *this;
+	}
+
+	// same text as an ostream with its default precision, "%g" with 6 digits
+	OutputBuffer& operator<<(float value) { return AppendFloat(value); }
+	OutputBuffer& operator<<(double value) { return AppendFloat(value); }
+
+	// bytes appended since construction or the last Clear, flushed ones included
+	size_t Size() const { return written + (size_t)(cursor - chunks.back().data.get()); }
+
+	// drops the text but keeps the first chunk for the next use
+	void Clear();
+
+	// copies the bytes [begin, end) of another buffer, offsets as returned by its Size()
+	void AppendRange(const OutputBuffer& from, size_t begin, size_t end);
+
+	// writes everything held to the flush descriptor and drops it, false when this or any
+	// write out before it failed
+	bool Flush();
+	bool WriteTo(int fd) const;
+	// writes a new file next to `path` and renames it over `path`, so a compile reading or
+	// writing the file at the same time never sees it half written. Only for buffers without
+	// a flush descriptor since flushed text is gone
+	bool WriteToFile(const char* path) const;
+
+private:
+	// creates or truncates the file, sizes it to the text and copies the chunks into a mapping of it
+	bool WriteMapped(const char* path) const;
+
+	struct Chunk
+	{
+		std::unique_ptr<char[]> data;
+		size_t size = 0;
+		size_t capacity = 0;
+	};
+
+	template<typename T>
+	OutputBuffer& AppendFloat(T value)
+	{
+		// "-1.23457e+308" and the like, with room to spare
+		auto first = Reserve(32);
+		cursor = std::to_chars(first, limit, value, std::chars_format::general, 6).ptr;
+		return *this;
+	}
+
+	// room for `size` contiguous bytes at the cursor
+	char* Reserve(size_t size)
+	{
+		if ((size_t)(limit - cursor) < size)
+		{
+			NextChunk(size);
+		}
+		return cursor;
+	}
+
+	void AppendSlow(const char* text, size_t size);
+	void NextChunk(size_t min_size);
+	// chunk sizes are only stored once the cursor has moved on to a later chunk
+	size_t ChunkSize(size_t index) const;
+
+	std::vector<Chunk> chunks;
+	char* cursor = nullptr;
+	char* limit = nullptr;
+	// bytes in the chunks before the current one and those already flushed
+	size_t written = 0;
+	// bytes that were flushed and are no longer held
+	size_t flushed = 0;
+	int flush_fd;
+	// a chunk written out when it filled up has nobody to tell, so it is remembered for Flush.
+	// Clear keeps it, the text is gone but the output still misses it
+	bool write_failed = false;
+};
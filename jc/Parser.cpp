@@ -1,63 +1,511 @@
 #include "Parser.hpp"
 #include <charconv>
 #include <cassert>
-
-
-Parser::Parser(Context* context)
+#include <atomic>
+#include <algorithm>
+#include <array>
+#include <mutex>
+
+// how tightly each binary operator holds on to its operands, indexed by TokenType,
+// 0 for tokens that are not binary operators
+static constexpr std::array<uint8_t, 256> BINARY_BINDING_POWER = []()
+{
+	std::array<uint8_t, 256> power{};
+	power[(size_t)TokenType::Or] = 1;
+	power[(size_t)TokenType::And] = 2;
+	power[(size_t)TokenType::EqualEqual] = 3;
+	power[(size_t)TokenType::NotEqual] = 3;
+	power[(size_t)TokenType::LessThan] = 4;
+	power[(size_t)TokenType::LessThanEqual] = 4;
+	power[(size_t)TokenType::GreaterThan] = 4;
+	power[(size_t)TokenType::GreaterThanEqual] = 4;
+	power[(size_t)TokenType::Plus] = 5;
+	power[(size_t)TokenType::Minus] = 5;
+	power[(size_t)TokenType::Star] = 6;
+	power[(size_t)TokenType::Slash] = 6;
+	power[(size_t)TokenType::Modulo] = 6;
+	return power;
+}();
+
+Parser::Parser(Context* context, Lexer* lexer)
 	:context(context)
+	, lexer(lexer)
+	, arena(&context->arena)
+	, errors(&context->errors)
 	, cursor(0)
+	, current_scope(context->root_scope)
 {
+	if (lexer)
+	{
+		context->tokens.SetWindow(STREAMING_TOKEN_WINDOW);
+	}
+}
 
+Parser::Parser(Context* context, Arena* arena)
+	:context(context)
+	, lexer(nullptr)
+	, arena(arena)
+	, errors(&context->errors)
+	, cursor(0)
+	, current_scope(context->root_scope)
+{
+	for (auto variable : context->root_scope->variables)
+	{
+		scope_stack.Declare(variable->symbol, variable);
+	}
 }
 
 void Parser::Parse()
+{
+	// the prepass needs every token up front, a streaming lexer only has a window of them
+	if (lexer)
+	{
+		ParseInOrder();
+	}
+	else
+	{
+		ParseWithPrepass();
+	}
+}
+
+void Parser::ParseInOrder()
 {
 	std::vector<Function*> functions;
 	std::vector<Statement*> statements;
 
-	while (Peek().type != TokenType::EndOfFile)
+	while (auto node = ParseNext(arena))
 	{
-		if (Peek().type == TokenType::Function)
+		if (node->node_type == ASTNodeType::Function)
 		{
-			functions.push_back(ParseFunction());
+			functions.push_back(static_cast<Function*>(node));
 		}
-		else if (Peek().type == TokenType::Let)
+		else
 		{
-			statements.push_back(ParseDeclarationStatement());
+			statements.push_back(static_cast<Statement*>(node));
 		}
-		else if (Peek().type == TokenType::Cpp)
+	}
+
+	context->CreateProgram(std::move(functions), std::move(statements));
+}
+
+ASTNode* Parser::ParseNext(Arena* function_arena)
+{
+	while (Peek() != TokenType::EndOfFile)
+	{
+		// declarations change what everyone looks up, a body only reads them
+		std::unique_lock<std::shared_mutex> lock;
+		if (declaration_lock)
 		{
-			statements.push_back(ParseCpp());
+			lock = std::unique_lock<std::shared_mutex>(*declaration_lock);
 		}
-		else if (Peek().type == TokenType::Struct)
+
+		if (Peek() == TokenType::Function)
+		{
+			auto declaration_arena = arena;
+			arena = function_arena;
+			auto begin = cursor;
+			auto function = ParseFunctionSignature();
+			function->begin = begin;
+			if (lock)
+			{
+				lock.unlock();
+			}
+			function->body_begin = cursor;
+			ParseFunctionBody(function, errors);
+			function->body_end = cursor;
+			arena = declaration_arena;
+			return function;
+		}
+		else if (Peek() == TokenType::Let)
+		{
+			return ParseDeclarationStatement();
+		}
+		else if (Peek() == TokenType::Cpp)
 		{
-			statements.push_back(ParseStruct());
+			return ParseCpp();
 		}
-		else if (Peek().type == TokenType::Extern)
+		else if (Peek() == TokenType::Struct && skimmed)
 		{
-			if (Peek(1).type == TokenType::Function)
+			SkipBraces();
+		}
+		else if (Peek() == TokenType::Struct)
+		{
+			return ParseStruct();
+		}
+		else if (Peek() == TokenType::Extern)
+		{
+			if (Peek(1) == TokenType::Function)
 			{
-				statements.push_back(ParseExternFunctionStatement());
+				return ParseExternFunctionStatement();
+			}
+			return ParseExternVariableStatement();
+		}
+		else if (Peek() == TokenType::Import)
+		{
+			// modules are found by scanning the whole token stream, a streaming lexer never has it
+			Error("Imports are not supported when streaming", PeekToken().line, PeekToken().column);
+			ParseImport();
+		}
+		else
+		{
+			Eat();
+			Error("Unexpected token: " + std::string(PeekToken().value), PeekToken().line, PeekToken().column);
+		}
+	}
+
+	return nullptr;
+}
+
+ASTNode* Parser::SkimNext(Arena* function_arena)
+{
+	// what is not a struct is parsed again by ParseNext, which reports its errors then
+	auto reported = errors;
+	std::vector<Message> ignored;
+	errors = &ignored;
+
+	ASTNode* result = nullptr;
+	while (!result && Peek() != TokenType::EndOfFile)
+	{
+		switch (Peek())
+		{
+		case TokenType::Function:
+		{
+			auto declaration_arena = arena;
+			arena = function_arena;
+			result = ParseFunctionSignature();
+			arena = declaration_arena;
+			SkipBraces();
+			break;
+		}
+		case TokenType::Struct:
+			if (skimmed)
+			{
+				SkipBraces();
 			}
 			else
 			{
-				statements.push_back(ParseExternVariableStatement());
+				errors = reported;
+				result = ParseStruct();
 			}
+			break;
+		case TokenType::Let:
+		case TokenType::Cpp:
+		case TokenType::Extern:
+		case TokenType::Import:
+			SkipStatement();
+			break;
+		default:
+			Eat();
+			break;
 		}
-		else
+	}
+
+	errors = reported;
+	return result;
+}
+
+void Parser::SkipBraces()
+{
+	while (Peek() != TokenType::LeftBrace && Peek() != TokenType::EndOfFile)
+	{
+		Eat();
+	}
+
+	size_t depth = 0;
+	while (Peek() != TokenType::EndOfFile)
+	{
+		auto kind = Eat().type;
+		if (kind == TokenType::LeftBrace)
+		{
+			depth++;
+		}
+		else if (kind == TokenType::RightBrace && --depth == 0)
+		{
+			return;
+		}
+	}
+}
+
+void Parser::SkipStatement()
+{
+	while (Peek() != TokenType::SemiColon && Peek() != TokenType::EndOfFile)
+	{
+		Eat();
+	}
+	if (Peek() == TokenType::SemiColon)
+	{
+		Eat();
+	}
+}
+
+void Parser::ParseWithPrepass()
+{
+	// every struct and signature is known before any body or global is parsed, so
+	// nothing has to be declared before it is used and the bodies can be parsed in any order
+	auto items = SkimItems();
+
+	for (auto& item : items)
+	{
+		if (item.kind == TokenType::Struct)
+		{
+			cursor = (int)item.begin;
+			errors = &item.errors;
+			item.statement = ParseStruct();
+		}
+	}
+
+	for (auto& item : items)
+	{
+		cursor = (int)item.begin;
+		errors = &item.errors;
+		if (item.kind == TokenType::Function)
+		{
+			item.function = ParseFunctionSignature();
+			item.function->begin = item.begin;
+			item.function->body_begin = cursor;
+			item.function->body_end = item.end;
+		}
+		else if (item.kind == TokenType::Extern && Peek(1) == TokenType::Function)
+		{
+			item.statement = ParseExternFunctionStatement();
+		}
+	}
+
+	for (auto& item : items)
+	{
+		cursor = (int)item.begin;
+		errors = &item.errors;
+		if (item.kind == TokenType::Let)
+		{
+			item.statement = ParseDeclarationStatement();
+		}
+		else if (item.kind == TokenType::Cpp)
+		{
+			item.statement = ParseCpp();
+		}
+		else if (item.kind == TokenType::Extern && Peek(1) != TokenType::Function)
+		{
+			item.statement = ParseExternVariableStatement();
+		}
+		else if (item.kind == TokenType::Import)
+		{
+			// Context::ScanImports has resolved it already, the declarations are imported
+			ParseImport();
+		}
+		else if (item.kind == TokenType::None)
 		{
 			Eat();
-			context->Error("Unexpected token: " + std::string(Peek().value), Peek().line, Peek().column);
+			Error("Unexpected token: " + std::string(PeekToken().value), PeekToken().line, PeekToken().column);
+		}
+	}
+
+	if (!context->lazy_bodies)
+	{
+		ParseFunctionBodies(items);
+	}
+
+	errors = &context->errors;
+	std::vector<Function*> functions;
+	std::vector<Statement*> statements;
+	for (auto& item : items)
+	{
+		if (item.function)
+		{
+			functions.push_back(item.function);
+		}
+		else if (item.statement)
+		{
+			statements.push_back(item.statement);
+		}
+		errors->insert(errors->end(), item.errors.begin(), item.errors.end());
+	}
+
+	context->CreateProgram(std::move(functions), std::move(statements));
+}
+
+std::vector<Parser::Item> Parser::SkimItems()
+{
+	// only looks at token kinds, a declaration ends at its closing brace or semicolon
+	const auto& tokens = context->tokens;
+	auto eof = tokens.Count() - 1;
+	std::vector<Item> items;
+
+	size_t index = 0;
+	while (tokens.Kind(index) != TokenType::EndOfFile)
+	{
+		Item item;
+		item.kind = tokens.Kind(index);
+		item.begin = index;
+
+		switch (item.kind)
+		{
+		case TokenType::Function:
+		case TokenType::Struct:
+			index = SkipPastMatchingBrace(index);
+			break;
+		case TokenType::Let:
+		case TokenType::Cpp:
+		case TokenType::Extern:
+		case TokenType::Import:
+			while (index < eof && tokens.Kind(index) != TokenType::SemiColon)
+			{
+				index++;
+			}
+			index = std::min(index + 1, eof);
+			break;
+		default:
+			item.kind = TokenType::None;
+			index++;
+			break;
 		}
+
+		item.end = index;
+		items.push_back(std::move(item));
 	}
 
-	context->CreateProgram(functions, statements);
+	return items;
+}
+
+size_t Parser::SkipPastMatchingBrace(size_t index)
+{
+	const auto& tokens = context->tokens;
+	auto eof = tokens.Count() - 1;
+	while (index < eof && tokens.Kind(index) != TokenType::LeftBrace)
+	{
+		index++;
+	}
+
+	size_t depth = 0;
+	for (; index < eof; index++)
+	{
+		auto kind = tokens.Kind(index);
+		if (kind == TokenType::LeftBrace)
+		{
+			depth++;
+		}
+		else if (kind == TokenType::RightBrace && --depth == 0)
+		{
+			return index + 1;
+		}
+	}
+	return eof;
+}
+
+void Parser::ParseFunctionBodies(std::vector<Item>& items)
+{
+	std::vector<Item*> pending;
+	for (auto& item : items)
+	{
+		if (item.function)
+		{
+			pending.push_back(&item);
+		}
+	}
+
+	auto& pool = context->GetThreadPool();
+	if (pool.ThreadCount() == 1 || pending.size() < MIN_PARALLEL_FUNCTIONS)
+	{
+		for (auto item : pending)
+		{
+			ParseFunctionBody(item->function, &item->errors);
+		}
+		return;
+	}
+
+	// each worker has its own parser, arena and scopes, they only share read only state
+	auto worker_count = pool.ThreadCount();
+	for (size_t worker = 0; worker < worker_count; worker++)
+	{
+		context->GetWorkerArena(worker);
+	}
+
+	std::atomic<size_t> next{ 0 };
+	pool.ParallelFor(worker_count, [&](size_t worker)
+	{
+		Parser parser(context, &context->GetWorkerArena(worker));
+		for (auto index = next++; index < pending.size(); index = next++)
+		{
+			parser.ParseFunctionBody(pending[index]->function, &pending[index]->errors);
+		}
+	});
+}
+
+void Parser::ParseFunctionBody(Function* function, std::vector<Message>* errors)
+{
+	this->errors = errors;
+	cursor = (int)function->body_begin;
+
+	PushScope();
+	for (const auto& param : function->prototype->params)
+	{
+		DeclareVariable(param.symbol, param.data_type);
+	}
+	// the parameters share the scope of the body
+	function->body = ParseBlock(false);
+	PopScope();
+}
+
+void Parser::PushScope()
+{
+	current_scope = arena->New<Scope>(scope_count++, current_scope);
+	scope_stack.Push();
+}
+
+void Parser::PopScope()
+{
+	scope_stack.Pop();
+	current_scope = current_scope->parent;
+}
+
+Variable* Parser::DeclareVariable(SymbolId name, Type data_type)
+{
+	auto variable = arena->New<Variable>(context->symbols.Name(name), name, data_type);
+	variable->scope = current_scope;
+	variable->slot = current_scope->variables.size();
+	current_scope->variables.push_back(variable);
+	scope_stack.Declare(name, variable);
+	return variable;
+}
+
+void Parser::Error(const std::string& text, size_t line, size_t column)
+{
+	errors->push_back(Message{ text, line, column });
+}
+
+Token Parser::GetToken(size_t index)
+{
+	Fill(index);
+	const auto& tokens = context->tokens;
+	auto line = tokens.Line(index);
+	if (line == 0)
+	{
+		return Token(tokens.Kind(index), tokens.Value(index), 0, 0, tokens.Symbol(index));
+	}
+
+	if (line != cached_line)
+	{
+		cached_line = line;
+		cached_line_start = tokens.LineStart(index);
+	}
+
+	return Token(tokens.Kind(index), tokens.Value(index), line, tokens.Offset(index) - cached_line_start, tokens.Symbol(index));
+}
+
+Variable* Parser::MakeVariable(const Token& token, Variable* declaration)
+{
+	auto result = arena->New<Variable>(token.value, token.symbol, declaration ? declaration->data_type : Type{});
+	if (declaration)
+	{
+		result->scope = declaration->scope;
+		result->slot = declaration->slot;
+	}
+	return result;
 }
 
 Expression* Parser::ParseFactor()
 {
 	// <factor> ::= <number> | <identifier> | <call> | "(" <expression> ")"
-	if (Peek().type == TokenType::Number)
+	if (Peek() == TokenType::Number)
 	{
 		auto t = Eat();
 		auto number = t.value;
@@ -171,51 +619,49 @@ Expression* Parser::ParseFactor()
 			}
 		}
 
-		auto result = new NumberLiteral(value);
+		auto result = arena->New<NumberLiteral>(value);
 		result->line = t.line;
 		result->column = t.column;
 
 		return result;
 	}
-	else if (Peek().type == TokenType::Identifier)
+	else if (Peek() == TokenType::Identifier)
 	{
-		if (Peek(1).type == TokenType::LeftParen)
+		if (Peek(1) == TokenType::LeftParen)
 		{
 			return ParseCallExpression();
 		}
-		else if (Peek(1).type == TokenType::Dot)
+		else if (Peek(1) == TokenType::Dot)
 		{
 			auto t = Eat();
-			auto identifier = t.value;
-			auto v = context->GetVariableFromScope(identifier);
+			auto v = scope_stack.Lookup(t.symbol);
 			if (v == nullptr)
 			{
-				std::string message = "Variable not found: " + std::string(identifier);
-				context->Error(message, Peek().line, Peek().column);
+				std::string message = "Variable not found: " + std::string(t.value);
+				Error(message, PeekToken().line, PeekToken().column);
 			}
 
-			auto result = ParseMemberAccessExpression(new Variable(identifier, v ? v->data_type : Type{}));
+			auto result = ParseMemberAccessExpression(MakeVariable(t, v));
 			result->line = t.line;
 			result->column = t.column;
 			return result;
 		}
 
 		auto t = Eat();
-		auto identifier = t.value;
 
-		auto v = context->GetVariableFromScope(identifier);
+		auto v = scope_stack.Lookup(t.symbol);
 		if (v == nullptr)
 		{
-			std::string message = "Variable not found: " + std::string(identifier);
-			context->Error(message, Peek().line, Peek().column);
+			std::string message = "Variable not found: " + std::string(t.value);
+			Error(message, PeekToken().line, PeekToken().column);
 		}
 
-		auto result = new Variable(identifier, v ? v->data_type : Type{});
+		auto result = MakeVariable(t, v);
 		result->line = t.line;
 		result->column = t.column;
 		return result;
 	}
-	else if (Peek().type == TokenType::LeftParen)
+	else if (Peek() == TokenType::LeftParen)
 	{
 		auto t = Eat();
 		auto expression = ParseExpression();
@@ -224,46 +670,40 @@ Expression* Parser::ParseFactor()
 		expression->column = t.column;
 		return expression;
 	}
-	else if (Peek().type == TokenType::StringLiteral)
+	else if (Peek() == TokenType::StringLiteral)
 	{
 		auto t = Eat();
-		auto result = new StringLiteral(t.value);
+		auto result = arena->New<StringLiteral>(t.value);
 		result->line = t.line;
 		result->column = t.column;
 		return result;
 	}
-	else if (IsUnaryOperator(Peek().type))
-	{
-		auto expression = ParseUnaryExpression();
-		return expression;
-	}
-
 
 	return nullptr;
 }
 
-Expression* Parser::ParseTerm()
+Expression* Parser::ParseBinaryExpression(uint8_t min_power)
 {
-	// <term> ::= <factor> | <term> "*" <factor> | <term> "/" <factor> | <term> "%" <factor>
-
-	auto t = Peek();
-	auto lhs = ParseFactor();
-	lhs->line = t.line;
-	lhs->column = t.column;
-	switch (Peek().type)
+	// <binary> ::= <unary> | <binary> <binary_operator> <binary>
+	// operators of the same power are folded in the loop, so chains stay left associative
+	// and only a tighter operator goes one call deeper, the depth is bounded by the number
+	// of precedence levels instead of the length of the chain
+
+	auto t = PeekToken();
+	auto lhs = ParseUnaryExpression();
+	while (lhs)
 	{
-		case TokenType::Star:
-		case TokenType::Slash:
-		case TokenType::Modulo:
+		auto power = BINARY_BINDING_POWER[(size_t)Peek()];
+		if (power <= min_power)
 		{
-			auto _t = Eat();
-			auto op = GetBinaryOperator(_t.type);
-			auto rhs = ParseFactor();
-			auto result = new BinaryExpression(lhs, op, rhs);
-			result->line = t.line;
-			result->column = t.column;
-			return result;
+			break;
 		}
+
+		auto op = GetBinaryOperator(Eat().type);
+		auto rhs = ParseBinaryExpression(power);
+		lhs = arena->New<BinaryExpression>(lhs, op, rhs);
+		lhs->line = t.line;
+		lhs->column = t.column;
 	}
 
 	return lhs;
@@ -271,33 +711,15 @@ Expression* Parser::ParseTerm()
 
 Expression* Parser::ParseExpression()
 {
-	//<expression> :: = <term> | <expression> ">" <term> | <expression> "<" <term> | <expression> ">=" <term> | < expression> "<=" <term>
-	//<term> :: = <factor> | <term> "+" <factor> | <term> "-" <factor>
+	// <expression> ::= <binary> | <binary> "=" <expression>
 
-	auto t = Peek();
-
-	auto lhs = ParseTerm();
-	lhs->line = t.line;
-	lhs->column = t.column;
-	if(Peek().type == TokenType::SemiColon)
-	{
-		return lhs;
-	}
-	else if (IsBinaryOperator(Peek().type))
+	auto t = PeekToken();
+	auto lhs = ParseBinaryExpression(0);
+	if (lhs && Peek() == TokenType::Equal)
 	{
-		auto _t = Eat();
-		auto op = GetBinaryOperator(_t.type);
+		Eat();
 		auto rhs = ParseExpression();
-		auto result = new BinaryExpression(lhs, op, rhs);
-		result->line = t.line;
-		result->column = t.column;
-		return result;
-	}
-	else if (Peek().type == TokenType::Equal)
-	{
-		auto _t = Eat();
-		auto rhs = ParseExpression();
-		auto result = new AssignmentExpression(lhs, rhs);
+		auto result = arena->New<AssignmentExpression>(lhs, rhs);
 		result->line = t.line;
 		result->column = t.column;
 		return result;
@@ -310,10 +732,10 @@ AssignmentExpression* Parser::ParseAssignmentExpression()
 {
 	// <assigment> ::= <identifier> "=" <expression>
 	auto t = Expect(TokenType::Identifier);
-	auto name = t.value;
+	auto lhs = MakeVariable(t, scope_stack.Lookup(t.symbol));
 	Expect(TokenType::Equal);
 	auto expression = ParseExpression();
-	auto result = new AssignmentExpression(new Variable(name, Type{}), expression);
+	auto result = arena->New<AssignmentExpression>(lhs, expression);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -323,10 +745,10 @@ AssignmentStatement* Parser::ParseAssignmentStatement()
 {
 	
 	// <assigment> ::= <identifier> "=" <expression> ";"
-	auto t = Peek();
+	auto t = PeekToken();
 	auto expression = ParseAssignmentExpression();
 	Expect(TokenType::SemiColon);
-	auto result = new AssignmentStatement(expression->lhs, expression->rhs);
+	auto result = arena->New<AssignmentStatement>(expression->lhs, expression->rhs);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -338,7 +760,7 @@ ReturnStatement* Parser::ParseReturnStatement()
 	auto t = Expect(TokenType::Return);
 	auto expression = ParseExpression();
 	Expect(TokenType::SemiColon);
-	auto result = new ReturnStatement(expression);
+	auto result = arena->New<ReturnStatement>(expression);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -351,40 +773,40 @@ CallExpression* Parser::ParseCallExpression()
 	// <expression> ::= <expression> | <call_expression>
 	auto t = Expect(TokenType::Identifier);
 	auto name = t.value;
-	auto p = context->GetFunctionPrototype(name);
+	auto p = context->GetFunctionPrototype(t.symbol);
 	if (p == nullptr)
 	{
-		context->Error("Function not found: " + std::string(name), Peek().line, Peek().column);
+		Error("Function not found: " + std::string(name), PeekToken().line, PeekToken().column);
 		return nullptr;
 	}
 
 	Expect(TokenType::LeftParen);
 	std::vector<Argument*> args;
-	while (Peek().type != TokenType::RightParen)
+	while (Peek() != TokenType::RightParen)
 	{
-		auto _t = Peek();
+		auto _t = PeekToken();
 
-		if (_t.type == TokenType::Identifier && Peek(1).type == TokenType::LeftParen)
+		if (_t.type == TokenType::Identifier && Peek(1) == TokenType::LeftParen)
 		{
-			auto exp = new Argument(ParseCallExpression());
+			auto exp = arena->New<Argument>(ParseCallExpression());
 			exp->line = _t.line;
 			exp->column = _t.column;
 			args.push_back(exp);
 		}
 		else
 		{
-			auto exp = new Argument(ParseExpression());
+			auto exp = arena->New<Argument>(ParseExpression());
 			exp->line = _t.line;
 			exp->column = _t.column;
 			args.push_back(exp);
 		}
-		if (Peek().type == TokenType::RightParen)
+		if (Peek() == TokenType::RightParen)
 			break;
 		Expect(TokenType::Comma);
 	}
 	Expect(TokenType::RightParen);
 
-	auto result = new CallExpression(name, args);
+	auto result = arena->New<CallExpression>(name, t.symbol, std::move(args));
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -398,22 +820,22 @@ CallStatement* Parser::ParseCallStatement()
 	auto name = t.value;
 	Expect(TokenType::LeftParen);
 	std::vector<Argument*> args;
-	while (Peek().type != TokenType::RightParen)
+	while (Peek() != TokenType::RightParen)
 	{
-		auto _t = Peek();
-		auto exp = new Argument(ParseExpression());
+		auto _t = PeekToken();
+		auto exp = arena->New<Argument>(ParseExpression());
 		exp->line = _t.line;
 		exp->column = _t.column;
 		args.push_back(exp);
 
-		if (Peek().type == TokenType::RightParen)
+		if (Peek() == TokenType::RightParen)
 			break;
 		Expect(TokenType::Comma);
 	}
 	Expect(TokenType::RightParen);
 	Expect(TokenType::SemiColon);
 
-	auto result = new CallStatement(name, args);
+	auto result = arena->New<CallStatement>(name, t.symbol, std::move(args));
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -422,15 +844,16 @@ CallStatement* Parser::ParseCallStatement()
 BlockNode* Parser::ParseBlock(bool create_new_scope)
 {
 	if(create_new_scope)
-		context->CreateScope();
+		PushScope();
+	auto scope = current_scope;
 
 	// <block> ::= "{" (<statements>* | e ) | ( <blocks>* | e ) "}"
 	auto t = Expect(TokenType::LeftBrace);
 	std::vector<Statement*> statements;
-	while (Peek().type != TokenType::RightBrace)
+	while (Peek() != TokenType::RightBrace)
 	{
 
-		if(Peek().type == TokenType::LeftBrace)
+		if(Peek() == TokenType::LeftBrace)
 		{
 			statements.push_back(ParseBlock());
 			continue;
@@ -450,9 +873,9 @@ BlockNode* Parser::ParseBlock(bool create_new_scope)
 	Expect(TokenType::RightBrace);
 
 	if (create_new_scope)
-		context->PopScope();
+		PopScope();
 
-	auto result = new BlockNode(statements, context->GetCurrentScopeIndex());
+	auto result = arena->New<BlockNode>(std::move(statements), scope);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -471,14 +894,14 @@ IfStatement* Parser::ParseIfStatement()
 	Expect(TokenType::RightBrace);
 	// eat else if available
 	BlockNode* elseBody = nullptr;
-	if (Peek().type == TokenType::Else)
+	if (Peek() == TokenType::Else)
 	{
 		Expect(TokenType::Else);
 		// eat <body>
 		elseBody = ParseBlock();
 	}
 
-	auto result = new IfStatement(expression, body, elseBody);
+	auto result = arena->New<IfStatement>(expression, body, elseBody);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -493,7 +916,7 @@ ForStatement* Parser::ParseForStatement()
 	Expect(TokenType::LeftParen);
 	// eat <assignment>
 	Statement* assignment = nullptr;
-	if (Peek().type != TokenType::SemiColon)
+	if (Peek() != TokenType::SemiColon)
 	{
 		assignment = ParseStatement();
 	}
@@ -505,7 +928,7 @@ ForStatement* Parser::ParseForStatement()
 //	Expect(TokenType::SemiColon);
 	// eat <expression>
 	Expression* condition = nullptr;
-	if (Peek().type != TokenType::SemiColon)
+	if (Peek() != TokenType::SemiColon)
 	{
 		condition = ParseExpression();
 	}
@@ -513,7 +936,7 @@ ForStatement* Parser::ParseForStatement()
 	Expect(TokenType::SemiColon);
 	// eat <expression>
 	Expression* inc = nullptr;
-	if (Peek().type != TokenType::RightParen)
+	if (Peek() != TokenType::RightParen)
 	{
 		inc = ParseExpression();
 	}
@@ -522,7 +945,7 @@ ForStatement* Parser::ParseForStatement()
 	// eat <body>
 	auto body = ParseBlock();
 
-	auto result = new ForStatement(assignment, condition, inc, body);
+	auto result = arena->New<ForStatement>(assignment, condition, inc, body);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -530,10 +953,10 @@ ForStatement* Parser::ParseForStatement()
 
 ExpressionStatement* Parser::ParseExpressionStatement()
 {
-	auto t = Peek();
+	auto t = PeekToken();
 	auto expression = ParseExpression();
 	Expect(TokenType::SemiColon);
-	auto result = new ExpressionStatement(expression);
+	auto result = arena->New<ExpressionStatement>(expression);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -541,14 +964,14 @@ ExpressionStatement* Parser::ParseExpressionStatement()
 
 Statement* Parser::ParseStatement()
 {
-	if (Peek().type == TokenType::Identifier)
+	if (Peek() == TokenType::Identifier)
 	{
-		if (Peek(1).type == TokenType::LeftParen)
+		if (Peek(1) == TokenType::LeftParen)
 		{
 			// TODO: does this even make sense?
 			return ParseCallStatement();
 		}
-		else if (Peek(1).type == TokenType::Equal)
+		else if (Peek(1) == TokenType::Equal)
 		{
 			return ParseAssignmentStatement();
 		}
@@ -559,25 +982,25 @@ Statement* Parser::ParseStatement()
 		// why are we here?
 		assert(false);
 	}
-	else if(Peek().type == TokenType::Cpp)
+	else if(Peek() == TokenType::Cpp)
 	{
 		return ParseCpp();
 	}
-	else if (Peek().type == TokenType::Return)
+	else if (Peek() == TokenType::Return)
 	{
 		return ParseReturnStatement();
 	}
-	else if (Peek().type == TokenType::If)
+	else if (Peek() == TokenType::If)
 	{
 		return ParseIfStatement();
 	}
-	else if (Peek().type == TokenType::For)
+	else if (Peek() == TokenType::For)
 	{
 		return ParseForStatement();
 	}
-	else if (Peek().type == TokenType::Extern)
+	else if (Peek() == TokenType::Extern)
 	{
-		if (Peek(1).type == TokenType::Function)
+		if (Peek(1) == TokenType::Function)
 		{
 			return ParseExternFunctionStatement();
 		}
@@ -586,7 +1009,7 @@ Statement* Parser::ParseStatement()
 			return ParseExternVariableStatement();
 		}
 	}
-	else if (Peek().type == TokenType::Let)
+	else if (Peek() == TokenType::Let)
 	{
 		return ParseDeclarationStatement();
 	}
@@ -598,84 +1021,107 @@ Statement* Parser::ParseStatement()
 	_assume(false);
 }
 
-Function* Parser::ParseFunction()
+static bool IsSameSignature(const FunctionPrototype& prototype, Type return_type, const std::vector<Parameter>& params)
 {
-	context->PushScope();
+	return prototype.return_type == return_type && prototype.params.size() == params.size() &&
+		std::equal(params.begin(), params.end(), prototype.params.begin(), [](const Parameter& a, const Parameter& b)
+		{
+			return a.symbol == b.symbol && a.data_type == b.data_type;
+		});
+}
 
+Function* Parser::ParseFunctionSignature()
+{
 	// eat fn
 	Expect(TokenType::Function);
 	// eat function name
-	auto name = Expect(TokenType::Identifier).value;
+	auto name = Expect(TokenType::Identifier);
 	// eat (
 	Expect(TokenType::LeftParen);
 
 	std::vector<Parameter> params;
-	while (Peek().type != TokenType::RightParen)
+	while (Peek() != TokenType::RightParen)
 	{
-		auto arg_name = Expect(TokenType::Identifier).value;
+		auto arg_name = Expect(TokenType::Identifier);
 		auto datatype = ExpectType();
-		params.emplace_back(arg_name, datatype);
-
-		context->AddVariableToScope(arg_name, datatype);
+		params.emplace_back(arg_name.value, arg_name.symbol, datatype);
 
-		if (Peek().type == TokenType::RightParen)
+		if (Peek() == TokenType::RightParen)
 			break;
 		Expect(TokenType::Comma);
 	}
 	Expect(TokenType::RightParen);
 	auto datatype = ExpectType();
-	// don't create a new scope
-	auto body = ParseBlock(false);
-	FunctionPrototype* protype = new FunctionPrototype(datatype, name, params);
-	context->functions[name] = protype;
 
-	context->PopScope();
+	// callers may have been resolved against the skimmed prototype already, and a second
+	// prototype per function would be memory the pipeline is there to save
+	auto skimmed_prototype = skimmed ? context->functions.Get(name.symbol) : nullptr;
+	if (skimmed_prototype && IsSameSignature(*skimmed_prototype, datatype, params))
+	{
+		return arena->New<Function>(skimmed_prototype, nullptr);
+	}
+
+	// registered before the body is parsed so functions can call themselves, and kept in
+	// the context's arena since it outlives the function when bodies get their own arena
+	FunctionPrototype* protype = context->arena.New<FunctionPrototype>(datatype, name.value, name.symbol, std::move(params));
+	context->functions.Set(name.symbol, protype);
 
-	return new Function(protype, body);
+	return arena->New<Function>(protype, nullptr);
 }
 
-UnaryExpression* Parser::ParseUnaryExpression()
+Expression* Parser::ParseUnaryExpression()
 {
-	// <unary> ::= <unary_operator> <expression>
-	auto t = Eat();
-	auto op_token = t.type;
-	auto expression = ParseExpression();
+	// <unary> ::= <unary_operator> <unary> | <factor>
+	if (!IsUnaryOperator(Peek()))
+	{
+		return ParseFactor();
+	}
 
-	UnaryExpression* result = nullptr;
+	// the operators are collected first and applied inside out, so a long run of them does not recurse
+	std::vector<Token> operators;
+	while (IsUnaryOperator(Peek()))
+	{
+		operators.push_back(Eat());
+	}
 
-	switch (op_token)
+	auto expression = ParseFactor();
+	if (expression == nullptr)
 	{
-	case TokenType::Plus:
-		result = new UnaryExpression(UnaryOperatorType::Plus, expression);
-		break;
-	case TokenType::Minus:
-		result = new UnaryExpression(UnaryOperatorType::Minus, expression);
-		break;
-	case TokenType::Not:
-		result = new UnaryExpression(UnaryOperatorType::Not, expression);
-		break;
-	default:
-		assert(false);
-		__assume(false);
+		return nullptr;
 	}
 
-	result->line = t.line;
-	result->column = t.column;
+	for (auto it = operators.rbegin(); it != operators.rend(); ++it)
+	{
+		UnaryOperatorType op;
+		switch (it->type)
+		{
+		case TokenType::Plus: op = UnaryOperatorType::Plus; break;
+		case TokenType::Minus: op = UnaryOperatorType::Minus; break;
+		case TokenType::Not: op = UnaryOperatorType::Not; break;
+		default:
+			assert(false);
+			__assume(false);
+		}
 
-	return result;
+		expression = arena->New<UnaryExpression>(op, expression);
+		expression->line = it->line;
+		expression->column = it->column;
+	}
+
+	return expression;
 }
 
 DeclarationStatement* Parser::ParseDeclarationStatement()
 {
 	// <assigment> ::= "let" <identifier> ( <data_type> | e ) "=" <expression> ";" 
 	auto t = Expect(TokenType::Let);
-	auto name = Expect(TokenType::Identifier).value;
+	auto name = Expect(TokenType::Identifier);
 	auto data_type = ExpectType();
-	if (Peek().type != TokenType::Equal)
+	if (Peek() != TokenType::Equal)
 	{
 		Expect(TokenType::SemiColon);
-		context->AddVariableToScope(name, data_type);
-		return new DeclarationStatement(name, data_type, nullptr);
+		DeclareVariable(name.symbol, data_type);
+		return arena->New<DeclarationStatement>(name.value, data_type, nullptr);
 	}
 	else
 	{
@@ -684,9 +1130,9 @@ DeclarationStatement* Parser::ParseDeclarationStatement()
 	auto expression = ParseExpression();
 	Expect(TokenType::SemiColon);
 
-	context->AddVariableToScope(name, data_type);
+	DeclareVariable(name.symbol, data_type);
 
-	auto result = new DeclarationStatement(name, data_type, expression);
+	auto result = arena->New<DeclarationStatement>(name.value, data_type, expression);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -696,27 +1142,35 @@ CppBlock* Parser::ParseCpp()
 {
 	auto t = Expect(TokenType::Cpp);
 	Expect(TokenType::SemiColon);
-	auto result = new CppBlock(t.value);
+	auto result = arena->New<CppBlock>(t.value);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
 }
 
+void Parser::ParseImport()
+{
+	// <import> := "import" <string_literal> ";"
+	Expect(TokenType::Import);
+	Expect(TokenType::StringLiteral);
+	Expect(TokenType::SemiColon);
+}
+
 ExternFunctionStatement* Parser::ParseExternFunctionStatement()
 {
 	// <extern_func> := "extern" "fn" <identifier> "(" <args> ")" <return_type> ";"
 	
 	auto t = Expect(TokenType::Extern);
 	Expect(TokenType::Function);
-	auto name = Expect(TokenType::Identifier).value;
+	auto name = Expect(TokenType::Identifier);
 	Expect(TokenType::LeftParen);
 	std::vector<Parameter> params;
-	while (Peek().type != TokenType::RightParen)
+	while (Peek() != TokenType::RightParen)
 	{
-		auto arg_name = Expect(TokenType::Identifier).value;
+		auto arg_name = Expect(TokenType::Identifier);
 		auto datatype = ExpectType();
-		params.emplace_back(arg_name, datatype);
-		if (Peek().type == TokenType::RightParen)
+		params.emplace_back(arg_name.value, arg_name.symbol, datatype);
+		if (Peek() == TokenType::RightParen)
 			break;
 		Expect(TokenType::Comma);
 	}
@@ -724,10 +1178,10 @@ ExternFunctionStatement* Parser::ParseExternFunctionStatement()
 	auto return_type = ExpectType();
 	Expect(TokenType::SemiColon);
 
-	auto prototype = new FunctionPrototype(return_type, name, params);
-	context->functions[name] = prototype;
+	auto prototype = arena->New<FunctionPrototype>(return_type, name.value, name.symbol, std::move(params));
+	context->functions.Set(name.symbol, prototype);
 
-	auto result = new ExternFunctionStatement(name, prototype);
+	auto result = arena->New<ExternFunctionStatement>(name.value, prototype);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -737,13 +1191,13 @@ ExternVariableStatement* Parser::ParseExternVariableStatement()
 {
 	// <extern_var> := "extern" <identifier> <data_type> ";"
 	auto t = Expect(TokenType::Extern);
-	auto name = Expect(TokenType::Identifier).value;
+	auto name = Expect(TokenType::Identifier);
 	auto data_type = ExpectType();
 	Expect(TokenType::SemiColon);
 
-	context->AddVariableToScope(name, data_type);
+	DeclareVariable(name.symbol, data_type);
 
-	auto result = new ExternVariableStatement(name, data_type);
+	auto result = arena->New<ExternVariableStatement>(name.value, data_type);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -752,26 +1206,33 @@ ExternVariableStatement* Parser::ParseExternVariableStatement()
 StructDefinationStatement* Parser::ParseStruct()
 {
 	auto t = Expect(TokenType::Struct);
-	auto name = Expect(TokenType::Identifier).value;
+	auto name = Expect(TokenType::Identifier);
 	Expect(TokenType::LeftBrace);
 	std::vector<StructField> fields;
-	while (Peek().type != TokenType::RightBrace)
+	while (Peek() != TokenType::RightBrace)
 	{
-		auto field_name = Expect(TokenType::Identifier).value;
+		auto field_name = Expect(TokenType::Identifier);
 		auto field_type = ExpectType();
-		fields.emplace_back(field_name, field_type);
-		if (Peek().type == TokenType::RightBrace)
+		fields.emplace_back(field_name.value, field_name.symbol, field_type);
+		if (Peek() == TokenType::RightBrace)
 			break;
 		Expect(TokenType::Comma);
 	}
 	Expect(TokenType::RightBrace);
 
-	context->CreateType(name);
+	if (context->types.Find(name.symbol).id != TYPE_UNKNOWN)
+	{
+		Error("Type " + std::string(name.value) + " already exists", 0, 0);
+	}
+	else
+	{
+		context->CreateType(name.symbol);
+	}
 
-	StructDefination* defination = new StructDefination(name, fields);
-	context->structs[name] = defination;
+	StructDefination* defination = arena->New<StructDefination>(name.value, name.symbol, std::move(fields));
+	context->structs.Set(name.symbol, defination);
 
-	auto result = new StructDefinationStatement(defination);
+	auto result = arena->New<StructDefinationStatement>(defination);
 	result->line = t.line;
 	result->column = t.column;
 	return result;
@@ -780,19 +1241,24 @@ StructDefinationStatement* Parser::ParseStruct()
 MemberAccessExpression* Parser::ParseMemberAccessExpression(Expression* lhs)
 {
 	auto t = Expect(TokenType::Dot);
-	auto member = Expect(TokenType::Identifier).value;
+	auto member = Expect(TokenType::Identifier);
 
 	Type result_type;
 
 	if (!lhs->data_type.IsPrimitive())
 	{
 		auto s = context->GetStructByType(lhs->data_type);
+		if (s == nullptr)
+		{
+			Error("Struct " + std::string(context->types.Name(lhs->data_type)) + " does not exist", 0, 0);
+			return nullptr; // TODO: handle this
+		}
 		const auto& fields = s->fields;
 		auto found = false;
 		StructField found_field;
 		for (const auto& field : fields)
 		{
-			if (field.name == member)
+			if (field.symbol == member.symbol)
 			{
 				found = true;
 				found_field = field;
@@ -802,7 +1268,7 @@ MemberAccessExpression* Parser::ParseMemberAccessExpression(Expression* lhs)
 
 		if (!found)
 		{
-			context->Error("Unknown member: " + std::string(member), Peek().line, Peek().column);
+			Error("Unknown member: " + std::string(member.value), PeekToken().line, PeekToken().column);
 			return nullptr; // TODO: handle this
 		}
 		
@@ -810,10 +1276,10 @@ MemberAccessExpression* Parser::ParseMemberAccessExpression(Expression* lhs)
 	}
 
 
-	auto result = new MemberAccessExpression(lhs, member);
+	auto result = arena->New<MemberAccessExpression>(lhs, member.value, member.symbol);
 	result->data_type = result_type;
 
-	if (Peek().type == TokenType::Dot)
+	if (Peek() == TokenType::Dot)
 	{
 		return ParseMemberAccessExpression(result);
 	}
@@ -826,7 +1292,7 @@ MemberAccessExpression* Parser::ParseMemberAccessExpression(Expression* lhs)
 
 Token Parser::Expect(TokenType type)
 {
-	if (Peek().type == type)
+	if (Peek() == type)
 	{
 		return Eat();
 	}
@@ -834,7 +1300,7 @@ Token Parser::Expect(TokenType type)
 	{
 		// TODO: fix this
 		auto error = "Expected something, got something else";
-		context->Error(error, Peek().line, Peek().column);
+		Error(error, PeekToken().line, PeekToken().column);
 		assert(false);
 	}
 
@@ -862,12 +1328,13 @@ Type Parser::ExpectType()
 	case TokenType::Void: return Type::get_void();
 	default:
 	{
-		// if the type is not yet defined the type generator will re-check for its type again
-		auto type = context->GetType(token.value);
-		if (type)
-			return *type;
-		else
-			return Type(TYPE_UNKNOWN, token.value);
+		// structs were given their handle when they were declared
+		auto type = context->types.Find(token.symbol);
+		if (type.id != TYPE_UNKNOWN)
+			return type;
+
+		Error("Type " + std::string(token.value) + " does not exist", 0, 0);
+		return Type{};
 	}
 	break;
 	}
@@ -901,6 +1368,7 @@ bool Parser::IsKeyword(TokenType type)
 	case TokenType::Function: return true;
 	case TokenType::Extern: return true;
 	case TokenType::Cpp: return true;
+	case TokenType::Import: return true;
 	case TokenType::Struct: return true;
 	}
 
@@ -945,23 +1413,7 @@ bool Parser::IsUnaryOperator(TokenType type)
 
 bool Parser::IsBinaryOperator(TokenType type)
 {
-	switch (type)
-	{
-	case TokenType::Plus: return true;
-	case TokenType::Minus: return true;
-	case TokenType::Star: return true;
-	case TokenType::Slash: return true;
-	case TokenType::Modulo: return true;
-	case TokenType::And: return true;
-	case TokenType::Or: return true;
-	case TokenType::EqualEqual: return true;
-	case TokenType::NotEqual: return true;
-	case TokenType::LessThan: return true;
-	case TokenType::LessThanEqual: return true;
-	case TokenType::GreaterThan: return true;
-	case TokenType::GreaterThanEqual: return true;
-	}
-	return false;
+	return BINARY_BINDING_POWER[(size_t)type] != 0;
 }
 
 BinaryOperatorType Parser::GetBinaryOperator(TokenType type)
@@ -976,6 +1428,7 @@ BinaryOperatorType Parser::GetBinaryOperator(TokenType type)
 	case TokenType::And: return BinaryOperatorType::And;
 	case TokenType::Or: return BinaryOperatorType::Or;
 	case TokenType::Equal: return BinaryOperatorType::Equal;
+	case TokenType::EqualEqual: return BinaryOperatorType::EqualEqual;
 	case TokenType::NotEqual: return BinaryOperatorType::NotEqual;
 	case TokenType::LessThan: return BinaryOperatorType::LessThan;
 	case TokenType::LessThanEqual: return BinaryOperatorType::LessThanEqual;
@@ -2,17 +2,53 @@
 #include "Lexer.hpp"
 #include "AST.hpp"
 #include "Context.hpp"
+#include "Scope.hpp"
+#include "ScopeStack.hpp"
+#include <shared_mutex>
+
+// tokens kept around when the parser pulls them from a streaming lexer, the parser
+// never looks more than two tokens ahead so this leaves plenty of room
+constexpr size_t STREAMING_TOKEN_WINDOW = 64;
+// below this many function bodies the pool costs more than it saves
+constexpr size_t MIN_PARALLEL_FUNCTIONS = 64;
 
 
 class Parser
 {
 public:
-	Parser(Context*);
+	// with a lexer the tokens are lexed on demand into a STREAMING_TOKEN_WINDOW ring,
+	// without one context->tokens has to hold the whole file already
+	Parser(Context*, Lexer* lexer = nullptr);
+	// a parser for function bodies only, its nodes are allocated from `arena` and it
+	// starts out seeing every global
+	Parser(Context*, Arena* arena);
 
 	void Parse();
+	// parses the body of a function whose signature was parsed already
+	void ParseFunctionBody(Function* function, std::vector<Message>* errors);
+	// parses the next top level declaration in source order, nullptr at the end of the file.
+	// A function and everything in its body is allocated from `function_arena`, which
+	// can be reset once the function is done with, what it declares stays in the parser's arena
+	ASTNode* ParseNext(Arena* function_arena);
+	// reads a streamed file ahead of ParseNext for what it declares: the next struct, or the
+	// next function with its signature parsed and its body stepped over, nullptr at the end
+	// of the file. Everything else is stepped over. Only errors in a struct are reported,
+	// ParseNext reports the others when it gets there
+	ASTNode* SkimNext(Arena* function_arena);
+
+	// where in the source the next token starts
+	size_t SourceOffset() { Fill(cursor); return context->tokens.Offset(cursor); }
+
+	// taken exclusively while a declaration is parsed, so others can read the declarations
+	// under a shared lock while bodies are being parsed
+	std::shared_mutex* declaration_lock = nullptr;
+	// SkimNext has read the file before: structs are parsed already and stepped over, and a
+	// signature that reads the same as the skimmed one keeps its prototype
+	bool skimmed = false;
 
-	inline Token Peek(int offset = 0) { return context->tokens[cursor + offset]; }
-	inline Token Eat() { return context->tokens[cursor++]; }
+	inline TokenType Peek(int offset = 0) { Fill(cursor + offset); return context->tokens.Kind(cursor + offset); }
+	inline Token PeekToken(int offset = 0) { return GetToken(cursor + offset); }
+	inline Token Eat() { return GetToken(cursor++); }
 	Token Expect(TokenType type);
 	Type ExpectType();
 	bool IsKeyword(TokenType type);
@@ -22,8 +58,46 @@ public:
 	BinaryOperatorType GetBinaryOperator(TokenType type);
 
 private:
+	// a top level declaration found by the prepass
+	struct Item
+	{
+		TokenType kind;
+		size_t begin;
+		size_t end;
+		Function* function = nullptr;
+		Statement* statement = nullptr;
+		std::vector<Message> errors;
+	};
+
+	void ParseInOrder();
+	void ParseWithPrepass();
+	std::vector<Item> SkimItems();
+	size_t SkipPastMatchingBrace(size_t index);
+	void ParseFunctionBodies(std::vector<Item>& items);
+	// the streaming counterparts of the prepass skipping, past the matching "}" of the next
+	// "{" and past the next ";"
+	void SkipBraces();
+	void SkipStatement();
+
+	Token GetToken(size_t index);
+	inline void Fill(size_t index)
+	{
+		while (lexer && index >= context->tokens.Count())
+		{
+			lexer->LexNext();
+		}
+	}
+	// a reference to `declaration`, unresolved when it is nullptr
+	Variable* MakeVariable(const Token& token, Variable* declaration);
+
+	void PushScope();
+	void PopScope();
+	Variable* DeclareVariable(SymbolId name, Type data_type);
+	void Error(const std::string& text, size_t line, size_t column);
+
 	Expression* ParseFactor();
-	Expression* ParseTerm();
+	// parses operators that bind tighter than min_power, 0 takes every binary operator
+	Expression* ParseBinaryExpression(uint8_t min_power);
 	Expression* ParseExpression();
 	AssignmentExpression* ParseAssignmentExpression();
 	AssignmentStatement* ParseAssignmentStatement();
@@ -35,15 +109,29 @@ private:
 	IfStatement* ParseIfStatement();
 	ForStatement* ParseForStatement();
 	Statement* ParseStatement();
-	Function* ParseFunction();
-	UnaryExpression* ParseUnaryExpression();
+	Function* ParseFunctionSignature();
+	Expression* ParseUnaryExpression();
 	DeclarationStatement* ParseDeclarationStatement();
 	CppBlock* ParseCpp();
+	void ParseImport();
 	ExternFunctionStatement* ParseExternFunctionStatement();
 	ExternVariableStatement* ParseExternVariableStatement();
 	StructDefinationStatement* ParseStruct();
 	MemberAccessExpression* ParseMemberAccessExpression(Expression* lhs);
 
 	Context* context;
+	Lexer* lexer;
+	Arena* arena;
+	// where diagnostics go, the prepass collects them per item to keep source order
+	std::vector<Message>* errors;
 	int cursor = 0;
+
+	// what is visible at the current point, references are resolved against it
+	ScopeStack scope_stack;
+	Scope* current_scope;
+	size_t scope_count = 1;
+
+	// tokens are consumed in order, so the start of the current line is looked up once per line
+	size_t cached_line = 0;
+	size_t cached_line_start = 0;
 };
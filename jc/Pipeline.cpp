@@ -0,0 +1,192 @@
+#include "Pipeline.hpp"
+#include <thread>
+
+Pipeline::Pipeline(Context* context)
+	: context(context)
+	, lexer(context)
+	, parser(context, &lexer)
+	, semantics(context)
+	, codegen(context)
+	, output(context->OpenOutput())
+{
+	semantics.SetDiagnostics(&errors, &warnings);
+	for (auto& arena : arenas)
+	{
+		free_arenas.push_back(&arena);
+	}
+}
+
+void Pipeline::Run()
+{
+	SkimDeclarations();
+	if (context->errors.empty())
+	{
+		for (auto node : structs)
+		{
+			codegen.Generate(output, node);
+		}
+	}
+
+	if (lexer.Begin())
+	{
+		if (context->GetThreadPool().ThreadCount() > 1)
+		{
+			RunOverlapped();
+		}
+		else
+		{
+			RunSerial();
+		}
+	}
+
+	context->CloseOutput(output);
+	context->errors.insert(context->errors.end(), errors.begin(), errors.end());
+	context->warnings.insert(context->warnings.end(), warnings.begin(), warnings.end());
+}
+
+void Pipeline::SkimDeclarations()
+{
+	// a signature can name a struct declared after it, which the first read has not seen
+	// yet. Those files are read a second time for the signatures alone
+	bool unresolved = false;
+	for (size_t pass = 0; pass == 0 || (pass == 1 && unresolved); ++pass)
+	{
+		// the lex errors are reported when the file is read for its bodies
+		std::vector<Message> lex_errors;
+		Lexer skim_lexer(context, &context->tokens, &context->symbols, &lex_errors);
+		if (!skim_lexer.Begin())
+		{
+			return;
+		}
+
+		Parser skimmer(context, &skim_lexer);
+		skimmer.skimmed = pass > 0;
+		auto arena = &arenas[0];
+		while (auto node = skimmer.SkimNext(arena))
+		{
+			context->source.Discard(skimmer.SourceOffset());
+			if (node->node_type == ASTNodeType::Function)
+			{
+				auto prototype = static_cast<Function*>(node)->prototype;
+				unresolved |= prototype->return_type.id == TYPE_UNKNOWN;
+				for (const auto& param : prototype->params)
+				{
+					unresolved |= param.data_type.id == TYPE_UNKNOWN;
+				}
+			}
+			else
+			{
+				structs.push_back(node);
+			}
+			arena->Reset();
+		}
+		context->source.Rewind();
+	}
+
+	context->tokens.SetWindow(STREAMING_TOKEN_WINDOW);
+	parser.skimmed = true;
+}
+
+void Pipeline::RunSerial()
+{
+	auto arena = &arenas[0];
+	while (auto node = parser.ParseNext(arena))
+	{
+		context->source.Discard(parser.SourceOffset());
+		// a declaration that failed to parse may be missing parts, it is only reported
+		if (context->errors.empty())
+		{
+			Process(node);
+		}
+		arena->Reset();
+	}
+}
+
+void Pipeline::RunOverlapped()
+{
+	parser.declaration_lock = &declaration_lock;
+	std::thread consumer(&Pipeline::Consume, this);
+
+	while (true)
+	{
+		Arena* arena;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this] { return !free_arenas.empty(); });
+			arena = free_arenas.back();
+			free_arenas.pop_back();
+		}
+
+		// only the parsing thread reports into the context while the pipeline runs
+		auto node = parser.ParseNext(arena);
+		context->source.Discard(parser.SourceOffset());
+		if (node && !context->errors.empty())
+		{
+			arena->Reset();
+			std::lock_guard<std::mutex> lock(mutex);
+			free_arenas.push_back(arena);
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ready.push_back(Item{ node, arena });
+		}
+		changed.notify_all();
+
+		if (!node)
+		{
+			break;
+		}
+	}
+
+	consumer.join();
+	parser.declaration_lock = nullptr;
+}
+
+void Pipeline::Consume()
+{
+	while (true)
+	{
+		Item item;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this] { return !ready.empty(); });
+			item = ready.front();
+			ready.pop_front();
+		}
+
+		if (!item.node)
+		{
+			return;
+		}
+
+		{
+			// declarations the parser adds meanwhile would move the tables being read
+			std::shared_lock<std::shared_mutex> lock(declaration_lock);
+			Process(item.node);
+		}
+
+		item.arena->Reset();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			free_arenas.push_back(item.arena);
+		}
+		changed.notify_all();
+	}
+}
+
+void Pipeline::Process(ASTNode* node)
+{
+	// only functions are checked, the same as when the whole program is compiled at once
+	if (node->node_type == ASTNodeType::Function)
+	{
+		semantics.Walk(node);
+	}
+
+	// checking goes on after an error so every error is reported, generating does not
+	if (errors.empty())
+	{
+		codegen.Generate(output, node);
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "Context.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "TypeGenerator.hpp"
+#include "TypeChecker.hpp"
+#include "CodeGen.hpp"
+#include "OutputBuffer.hpp"
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <deque>
+
+// functions that can be parsed ahead of the one being generated, each of them has an arena
+constexpr size_t PIPELINE_DEPTH = 4;
+
+// Compiles a file one top level declaration at a time. The file is streamed through once
+// for its structs and function signatures, so a function can use what is declared after
+// it, like it can when the whole program is compiled at once. Then it is streamed again:
+// tokens are lexed on demand, and as soon as a function is parsed it is type checked and
+// generated, then its arena is reset for a later function. Only the declarations stay
+// alive and the source that has been parsed is handed back to the system, so memory does
+// not grow with the bodies. With more than one thread the parser runs ahead on the calling
+// thread while another one checks and generates, up to PIPELINE_DEPTH functions behind.
+// The structs are written first, everything else follows in source order. Unlike a whole
+// program compile, the text of the declarations before the first error has been written
+// already when that error is found.
+class Pipeline
+{
+public:
+	explicit Pipeline(Context* context);
+
+	void Run();
+
+private:
+	// a parsed declaration and the arena its function lives in
+	struct Item
+	{
+		ASTNode* node;
+		Arena* arena;
+	};
+
+	// every struct and function signature, parsed into the context before any body is
+	void SkimDeclarations();
+	void RunSerial();
+	void RunOverlapped();
+	void Consume();
+	void Process(ASTNode* node);
+
+	Context* context;
+	Lexer lexer;
+	Parser parser;
+	FusedPass<TypeGenertaor, TypeChecker> semantics;
+	CodeGen codegen;
+	OutputBuffer output;
+
+	// found by SkimDeclarations, written before anything else
+	std::vector<ASTNode*> structs;
+	// semantic diagnostics, kept apart since the parser reports into the context meanwhile
+	std::vector<Message> errors;
+	std::vector<Message> warnings;
+
+	Arena arenas[PIPELINE_DEPTH];
+	std::shared_mutex declaration_lock;
+	std::mutex mutex;
+	std::condition_variable changed;
+	// parsed and waiting to be generated, a nullptr node marks the end of the file
+	std::deque<Item> ready;
+	std::vector<Arena*> free_arenas;
+};
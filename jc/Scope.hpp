@@ -1,18 +1,14 @@
 #pragma once
-#include <unordered_map>
-#include <string_view>
+#include <vector>
 #include "AST.hpp"
 
-struct Context;
-
 struct Scope
 {
-	size_t parent;
+	Scope* parent;
+	// numbered in the order the parser opened them, the root scope is 0
 	size_t index;
-	Context* context;
-	std::unordered_map<std::string_view, Variable*> variables;
-
-	explicit Scope(size_t index, size_t parent, Context* context);
+	// declarations made directly in this scope, a resolved Variable::slot indexes into it
+	std::vector<Variable*> variables;
 
-	Variable* GetVariable(const std::string_view& name);
+	explicit Scope(size_t index, Scope* parent);
 };
@@ -0,0 +1,39 @@
+#include "ScopeStack.hpp"
+#include <cassert>
+
+void ScopeStack::Push()
+{
+	marks.push_back((uint32_t)entries.size());
+}
+
+void ScopeStack::Pop()
+{
+	assert(!marks.empty());
+	auto mark = marks.back();
+	marks.pop_back();
+
+	while (entries.size() > mark)
+	{
+		const auto& entry = entries.back();
+		heads[entry.symbol] = entry.shadowed;
+		entries.pop_back();
+	}
+}
+
+void ScopeStack::Declare(SymbolId symbol, Variable* variable)
+{
+	if (symbol >= heads.size())
+	{
+		heads.resize((size_t)symbol + 1, NO_ENTRY);
+	}
+
+	entries.push_back(Entry{ symbol, heads[symbol], variable });
+	heads[symbol] = (uint32_t)entries.size() - 1;
+}
+
+void ScopeStack::Clear()
+{
+	entries.clear();
+	heads.clear();
+	marks.clear();
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "SymbolTable.hpp"
+
+struct Variable;
+
+// The names visible at the current point of the parse. Every declaration is appended to
+// one flat entry list and `heads` points each symbol at its innermost entry, an entry
+// remembers the one it shadows. Pushing a scope records a mark, popping truncates back
+// to it and restores the shadowed heads, so lookup, push and pop are all O(1).
+class ScopeStack
+{
+public:
+	void Push();
+	void Pop();
+
+	void Declare(SymbolId symbol, Variable* variable);
+	// innermost visible declaration, nullptr when the name is not in scope
+	Variable* Lookup(SymbolId symbol) const
+	{
+		if (symbol >= heads.size() || heads[symbol] == NO_ENTRY)
+			return nullptr;
+
+		return entries[heads[symbol]].variable;
+	}
+
+	size_t Depth() const { return marks.size(); }
+	void Clear();
+
+private:
+	static constexpr uint32_t NO_ENTRY = UINT32_MAX;
+
+	struct Entry
+	{
+		SymbolId symbol;
+		uint32_t shadowed;
+		Variable* variable;
+	};
+
+	std::vector<Entry> entries;
+	// indexed by SymbolId, symbols are dense so this is a plain array
+	std::vector<uint32_t> heads;
+	std::vector<uint32_t> marks;
+};
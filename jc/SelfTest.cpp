@@ -0,0 +1,218 @@
+#include "SelfTest.hpp"
+#include "Bench.hpp"
+#include "Lexer.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <random>
+#include <utility>
+
+SelfTest::SelfTest(const char* path)
+	: path(path)
+{
+}
+
+bool SelfTest::Run()
+{
+	bool passed = true;
+	passed &= CheckRelex();
+	passed &= CheckDeepExpression();
+	passed &= CheckPipelineOrder();
+	return passed;
+}
+
+bool SelfTest::CheckRelex()
+{
+	Context context(path.c_str());
+	if (!context.errors.empty())
+	{
+		std::cout << "Relex: could not read " << path << std::endl;
+		return false;
+	}
+
+	// long enough that the gap of the token buffer has many tokens to move across
+	auto text = std::make_unique<std::string>();
+	do
+	{
+		text->append(context.input);
+	} while (text->size() < 16 * 1024);
+	context.input = *text;
+	context.Lex();
+
+	// bits of tokens, strings, comments and cpp blocks get cut open and closed again
+	const char* pieces[] = { "a", "b", "1", " ", "\n", "\t", "\"", "/", "//", "{", "}", "}}", "cpp{", "=", "*",
+		"$", ".", "0x", "fn", "x1", "let ", "\"s\"" };
+	// reset for every edit, so its memory is only paid for once
+	Context reference(path.c_str());
+	std::mt19937 random(seed);
+	size_t next_begin = text->size() / 2;
+	for (size_t i = 0; i < edit_count; ++i)
+	{
+		// mostly typing at one place, now and then somewhere else. The last byte is left
+		// alone, the input keeps ending the way the file did
+		auto last = text->size() - 1;
+		auto begin = random() % 4 == 0 ? random() % last : (next_begin + random() % 8) % last;
+		auto end = std::min(last, begin + (random() % 8 == 0 ? random() % 12 : random() % 3));
+		std::string inserted;
+		for (auto count = random() % 5; count > 0; --count)
+		{
+			inserted += pieces[random() % std::size(pieces)];
+		}
+		next_begin = begin + inserted.size();
+
+		// the old text has to stay alive until Relex returns
+		auto edited = std::make_unique<std::string>(text->substr(0, begin) + inserted + text->substr(end));
+		context.Relex(*edited, TextEdit{ begin, end, std::string_view(*edited).substr(begin, inserted.size()) });
+		text = std::move(edited);
+
+		reference.Reset(path.c_str());
+		reference.input = *text;
+		Lexer(&reference).Lex();
+
+		std::string why;
+		if (!SameLex(context, reference, why))
+		{
+			std::cout << "Relex: edit " << i << " replacing [" << begin << ", " << end << ") with \"" << inserted
+				<< "\" differs from a full lex, " << why << std::endl;
+			return false;
+		}
+	}
+
+	std::cout << "Relex: " << edit_count << " edits lexed the same as from scratch (" << context.tokens.Count()
+		<< " tokens, " << context.errors.size() << " errors)" << std::endl;
+	return true;
+}
+
+bool SelfTest::CheckDeepExpression()
+{
+	auto text = Bench::GenerateExpression(DEEP_EXPRESSION_OPERANDS);
+	std::pair<const char*, std::function<void(Context*)>> modes[] = {
+		{ "whole program", [](Context*) {} },
+		{ "--two-pass", [](Context* context) { context->fused_semantics = false; } },
+		{ "--pipeline", [](Context* context) { context->pipeline = context->stream_tokens = true; } },
+	};
+	for (auto& [name, configure] : modes)
+	{
+		std::string output;
+		if (!Compile(text, configure, output) || output.empty())
+		{
+			std::cout << "Deep expression: " << DEEP_EXPRESSION_OPERANDS << " operands did not compile " << name << std::endl;
+			return false;
+		}
+	}
+
+	std::cout << "Deep expression: " << DEEP_EXPRESSION_OPERANDS << " operands compiled whole program, --two-pass and --pipeline"
+		<< std::endl;
+	return true;
+}
+
+bool SelfTest::CheckPipelineOrder()
+{
+	const std::string text =
+		"fn length(p Point) f32\n{\n\treturn p.x * p.x + p.y * p.y;\n}\n\n"
+		"fn main() i32\n{\n\tlet p Point;\n\tp.x = 3.0;\n\tp.y = later(p.x);\n\tlet l f32 = length(p);\n\treturn 0;\n}\n\n"
+		"struct Point\n{\n\tx f32,\n\ty f32,\n}\n\n"
+		"fn later(a f32) f32\n{\n\treturn a;\n}\n";
+
+	std::string expected;
+	if (!Compile(text, [](Context*) {}, expected))
+	{
+		std::cout << "Pipeline order: the whole program compile failed" << std::endl;
+		return false;
+	}
+
+	for (size_t thread_count : { 1, 2 })
+	{
+		std::string output;
+		auto configure = [&](Context* context)
+		{
+			context->pipeline = context->stream_tokens = true;
+			context->thread_count = thread_count;
+		};
+		if (!Compile(text, configure, output) || output != expected)
+		{
+			std::cout << "Pipeline order: --pipeline -j " << thread_count << " differs from a whole program compile" << std::endl;
+			return false;
+		}
+	}
+
+	std::cout << "Pipeline order: declarations used before they appear compile the same" << std::endl;
+	return true;
+}
+
+bool SelfTest::Compile(const std::string& text, const std::function<void(Context*)>& configure, std::string& output)
+{
+	auto input_path = Bench::WriteInput("jc_self_test.jin", text);
+	if (input_path.empty())
+	{
+		return false;
+	}
+	auto output_path = (std::filesystem::temp_directory_path() / "jc_self_test.cpp").string();
+
+	bool compiled;
+	{
+		Context context(input_path.c_str());
+		configure(&context);
+		context.output_path = output_path.c_str();
+		context.Compile();
+		compiled = context.errors.empty();
+		if (!compiled)
+		{
+			context.PrintMessages();
+		}
+	}
+
+	std::ifstream file(output_path, std::ios::binary);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	output = contents.str();
+	file.close();
+
+	std::error_code error;
+	std::filesystem::remove(input_path, error);
+	std::filesystem::remove(output_path, error);
+	return compiled;
+}
+
+bool SelfTest::SameLex(const Context& context, const Context& reference, std::string& why)
+{
+	auto& tokens = context.tokens;
+	auto& expected = reference.tokens;
+	if (tokens.Count() != expected.Count())
+	{
+		why = std::to_string(tokens.Count()) + " tokens instead of " + std::to_string(expected.Count());
+		return false;
+	}
+	for (size_t i = 0; i < tokens.Count(); ++i)
+	{
+		if (tokens.Kind(i) != expected.Kind(i) || tokens.Offset(i) != expected.Offset(i) || tokens.Line(i) != expected.Line(i) ||
+			tokens.Column(i) != expected.Column(i) || tokens.Value(i) != expected.Value(i))
+		{
+			why = "token " + std::to_string(i) + " \"" + std::string(tokens.Value(i)) + "\" at " + std::to_string(tokens.Line(i)) +
+				":" + std::to_string(tokens.Column(i)) + " instead of \"" + std::string(expected.Value(i)) + "\" at " +
+				std::to_string(expected.Line(i)) + ":" + std::to_string(expected.Column(i));
+			return false;
+		}
+	}
+
+	if (context.errors.size() != reference.errors.size())
+	{
+		why = std::to_string(context.errors.size()) + " errors instead of " + std::to_string(reference.errors.size());
+		return false;
+	}
+	for (size_t i = 0; i < context.errors.size(); ++i)
+	{
+		auto& error = context.errors[i];
+		auto& expected_error = reference.errors[i];
+		if (error.text != expected_error.text || error.line != expected_error.line || error.column != expected_error.column)
+		{
+			why = "error " + std::to_string(i) + " \"" + error.text + "\" at " + std::to_string(error.line) + ":" +
+				std::to_string(error.column) + " instead of \"" + expected_error.text + "\" at " +
+				std::to_string(expected_error.line) + ":" + std::to_string(expected_error.column);
+			return false;
+		}
+	}
+	return true;
+}
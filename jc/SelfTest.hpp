@@ -0,0 +1,40 @@
+#pragma once
+#include "Context.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Checks of the compiler against itself that no single input shows, see `jc --self-test`.
+// Each check prints one line and the run fails when any of them does.
+class SelfTest
+{
+public:
+	// `path` is the source the checks start from
+	explicit SelfTest(const char* path);
+
+	// false when any check failed
+	bool Run();
+
+private:
+	// random edits are relexed one after another, after each one the tokens and errors have
+	// to be what lexing the edited text from scratch gives
+	bool CheckRelex();
+	// one expression of DEEP_EXPRESSION_OPERANDS operands compiles on the stack main was
+	// given, whole program, with --two-pass and with --pipeline. The parser and every
+	// pass after it used to recurse once per operator
+	bool CheckDeepExpression();
+	// a function before the struct it takes and the function it calls compiles the same
+	// with --pipeline, serial and overlapped, as it does as a whole program
+	bool CheckPipelineOrder();
+	// generated code of `text` compiled from a file of its own, `configure` picks the mode.
+	// False when the file could not be written or the compile had errors, which are printed
+	static bool Compile(const std::string& text, const std::function<void(Context*)>& configure, std::string& output);
+	// the tokens and errors of `context` are those of `reference`, `why` says where not
+	static bool SameLex(const Context& context, const Context& reference, std::string& why);
+
+	std::string path;
+	// the same edits every run, so a failure can be run again
+	uint32_t seed = 1;
+	size_t edit_count = 2000;
+	static constexpr size_t DEEP_EXPRESSION_OPERANDS = 100000;
+};
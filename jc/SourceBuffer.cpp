@@ -0,0 +1,254 @@
+#include "SourceBuffer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SourceBuffer::~SourceBuffer()
+{
+	Close();
+}
+
+bool SourceBuffer::Open(const char* path)
+{
+	Close();
+
+	if (std::strcmp(path, "-") != 0 && Map(path))
+	{
+		return true;
+	}
+
+	return Read(path);
+}
+
+void SourceBuffer::Close()
+{
+	if (mapped)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+		CloseHandle(mapping);
+		mapping = nullptr;
+#else
+		munmap(base, base_size);
+#endif
+	}
+	else
+	{
+		std::free(base);
+	}
+
+	data = nullptr;
+	size = 0;
+	mapped = false;
+	base = nullptr;
+	base_size = 0;
+	discarded = 0;
+}
+
+void SourceBuffer::Discard(size_t end)
+{
+	// one call per a few pages would cost more than the memory it gives back
+	constexpr size_t MIN_DISCARD_SIZE = 1024 * 1024;
+	if (!mapped || end < discarded + MIN_DISCARD_SIZE)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	size_t page_size = info.dwPageSize;
+#else
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	end &= ~(page_size - 1);
+
+	auto first = static_cast<char*>(base) + discarded;
+#ifdef _WIN32
+	// unlocking pages that are not locked takes them out of the working set
+	VirtualUnlock(first, end - discarded);
+#else
+	madvise(first, end - discarded, MADV_DONTNEED);
+#endif
+	discarded = end;
+}
+
+#ifdef _WIN32
+
+bool SourceBuffer::Map(const char* path)
+{
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// the zero filled tail of the last page is the sentinel, page aligned files are read instead
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	if (file_size.QuadPart % info.dwPageSize == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping_handle)
+	{
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping_handle);
+		return false;
+	}
+
+	data = static_cast<const char*>(view);
+	size = (size_t)file_size.QuadPart;
+	mapped = true;
+	base = view;
+	base_size = size;
+	mapping = mapping_handle;
+	return true;
+}
+
+#else
+
+bool SourceBuffer::Map(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	size_t file_size = (size_t)info.st_size;
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t reserve_size = (file_size + 1 + page_size - 1) & ~(page_size - 1);
+
+	// reserve the file size plus at least one zero byte of anonymous memory,
+	// then map the file over the front of it, what is left over is the sentinel
+	void* region = mmap(nullptr, reserve_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(region, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+	{
+		munmap(region, reserve_size);
+		return false;
+	}
+
+	madvise(view, file_size, MADV_SEQUENTIAL);
+
+	data = static_cast<const char*>(view);
+	size = file_size;
+	mapped = true;
+	base = region;
+	base_size = reserve_size;
+	return true;
+}
+
+#endif
+
+bool SourceBuffer::Read(const char* path)
+{
+	FILE* file = nullptr;
+	bool is_stdin = std::strcmp(path, "-") == 0;
+	if (is_stdin)
+	{
+		file = stdin;
+	}
+	else
+	{
+#ifdef _WIN32
+		fopen_s(&file, path, "rb");
+#else
+		file = std::fopen(path, "rb");
+#endif
+	}
+
+	if (!file)
+	{
+		return false;
+	}
+
+	size_t capacity = 64 * 1024;
+	size_t length = 0;
+	char* buffer = static_cast<char*>(std::malloc(capacity));
+
+	while (buffer)
+	{
+		// always keep one byte free for the sentinel
+		if (capacity - length == 1)
+		{
+			auto grown = static_cast<char*>(std::realloc(buffer, capacity * 2));
+			if (!grown)
+			{
+				std::free(buffer);
+				buffer = nullptr;
+				break;
+			}
+			buffer = grown;
+			capacity *= 2;
+		}
+
+		auto count = std::fread(buffer + length, 1, capacity - length - 1, file);
+		if (count == 0)
+		{
+			break;
+		}
+		length += count;
+	}
+
+	if (!is_stdin)
+	{
+		std::fclose(file);
+	}
+
+	if (!buffer)
+	{
+		return false;
+	}
+
+	buffer[length] = '\0';
+	data = buffer;
+	size = length;
+	mapped = false;
+	base = buffer;
+	base_size = capacity;
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <string_view>
+#include <cstddef>
+
+// Read-only contents of an input file. Regular files are memory mapped, pipes and stdin
+// ("-") are read into an owned buffer. Either way the byte right after the data is
+// guaranteed to be '\0', so the lexer can peek one character ahead without a bounds check.
+class SourceBuffer
+{
+public:
+	SourceBuffer() = default;
+	~SourceBuffer();
+
+	SourceBuffer(const SourceBuffer&) = delete;
+	SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	std::string_view View() const { return std::string_view(data, size); }
+	bool IsMapped() const { return mapped; }
+
+	// the bytes before `end` will not be looked at for a while, mapped pages are dropped
+	// and read back from the file if they are, so the data stays valid either way
+	void Discard(size_t end);
+	// the data is read again from the start, Discard gives back what that brings in again
+	void Rewind() { discarded = 0; }
+
+private:
+	bool Map(const char* path);
+	bool Read(const char* path);
+
+	const char* data = nullptr;
+	size_t size = 0;
+	bool mapped = false;
+
+	// mapped: the reserved address range, owned: the heap buffer
+	void* base = nullptr;
+	size_t base_size = 0;
+	// everything before it has been discarded already
+	size_t discarded = 0;
+#ifdef _WIN32
+	void* mapping = nullptr;
+#endif
+};
@@ -0,0 +1,111 @@
+#include "SymbolTable.hpp"
+#include <cstring>
+
+static constexpr size_t INITIAL_SLOT_COUNT = 1024;
+
+SymbolTable::SymbolTable()
+	: storage(64 * 1024)
+{
+	slots.assign(INITIAL_SLOT_COUNT, Slot{ 0, INVALID_SYMBOL });
+}
+
+SymbolId SymbolTable::Intern(std::string_view name)
+{
+	auto hash = Hash(name);
+	auto mask = slots.size() - 1;
+
+	for (auto index = hash & mask;; index = (index + 1) & mask)
+	{
+		auto& slot = slots[index];
+		if (slot.id == INVALID_SYMBOL)
+		{
+			auto copy = static_cast<char*>(storage.Allocate(name.size(), 1));
+			std::memcpy(copy, name.data(), name.size());
+
+			auto id = (SymbolId)names.size();
+			names.emplace_back(copy, name.size());
+			slot = Slot{ hash, id };
+
+			// keep the load factor under one half
+			if (names.size() * 2 > slots.size())
+			{
+				Rehash(slots.size() * 2);
+			}
+			return id;
+		}
+
+		if (slot.hash == hash && names[slot.id] == name)
+		{
+			return slot.id;
+		}
+	}
+}
+
+SymbolId SymbolTable::Find(std::string_view name) const
+{
+	auto hash = Hash(name);
+	auto mask = slots.size() - 1;
+
+	for (auto index = hash & mask;; index = (index + 1) & mask)
+	{
+		const auto& slot = slots[index];
+		if (slot.id == INVALID_SYMBOL || (slot.hash == hash && names[slot.id] == name))
+		{
+			return slot.id;
+		}
+	}
+}
+
+void SymbolTable::Reserve(size_t count)
+{
+	auto slot_count = slots.size();
+	while (slot_count < count * 2)
+	{
+		slot_count *= 2;
+	}
+
+	if (slot_count != slots.size())
+	{
+		Rehash(slot_count);
+	}
+	names.reserve(count);
+}
+
+void SymbolTable::Clear()
+{
+	names.clear();
+	slots.assign(INITIAL_SLOT_COUNT, Slot{ 0, INVALID_SYMBOL });
+	storage.Reset();
+}
+
+uint32_t SymbolTable::Hash(std::string_view name)
+{
+	// FNV-1a, identifiers are short so this beats anything with a setup cost
+	uint32_t hash = 2166136261u;
+	for (auto c : name)
+	{
+		hash ^= (uint8_t)c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+void SymbolTable::Rehash(size_t slot_count)
+{
+	std::vector<Slot> old_slots(slot_count, Slot{ 0, INVALID_SYMBOL });
+	old_slots.swap(slots);
+	auto mask = slots.size() - 1;
+
+	for (const auto& slot : old_slots)
+	{
+		if (slot.id == INVALID_SYMBOL)
+			continue;
+
+		auto index = slot.hash & mask;
+		while (slots[index].id != INVALID_SYMBOL)
+		{
+			index = (index + 1) & mask;
+		}
+		slots[index] = slot;
+	}
+}
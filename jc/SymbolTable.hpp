@@ -0,0 +1,70 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "Arena.hpp"
+
+using SymbolId = uint32_t;
+constexpr SymbolId INVALID_SYMBOL = UINT32_MAX;
+
+// Interns identifiers into dense 32 bit ids. The lexer interns every identifier once,
+// after that names are compared and looked up by id. The text is copied into storage
+// owned by the table, so names stay valid independent of the source buffer.
+class SymbolTable
+{
+public:
+	SymbolTable();
+
+	SymbolId Intern(std::string_view name);
+	// INVALID_SYMBOL when the name was never interned
+	SymbolId Find(std::string_view name) const;
+	// sizes the table for about `count` names so interning does not rehash
+	void Reserve(size_t count);
+
+	// empty for INVALID_SYMBOL, so error messages can print any id
+	std::string_view Name(SymbolId id) const { return id < names.size() ? names[id] : std::string_view(); }
+	size_t Count() const { return names.size(); }
+
+	void Clear();
+
+private:
+	// the hash is kept next to the id so a probe only touches the name on a real match
+	struct Slot
+	{
+		uint32_t hash;
+		SymbolId id;
+	};
+
+	static uint32_t Hash(std::string_view name);
+	void Rehash(size_t slot_count);
+
+	std::vector<std::string_view> names;
+	// open addressing with linear probing, INVALID_SYMBOL marks an empty slot
+	std::vector<Slot> slots;
+	Arena storage;
+};
+
+// Side table keyed by SymbolId. Symbol ids are dense, so this is a plain array index.
+template<typename T>
+class SymbolMap
+{
+public:
+	T* Get(SymbolId id) const
+	{
+		return id < entries.size() ? entries[id] : nullptr;
+	}
+
+	void Set(SymbolId id, T* value)
+	{
+		if (id >= entries.size())
+		{
+			entries.resize((size_t)id + 1, nullptr);
+		}
+		entries[id] = value;
+	}
+
+	void Clear() { entries.clear(); }
+
+private:
+	std::vector<T*> entries;
+};
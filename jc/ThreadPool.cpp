@@ -0,0 +1,158 @@
+#include "ThreadPool.hpp"
+#include <cassert>
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+	if (thread_count == 0)
+	{
+		thread_count = std::thread::hardware_concurrency();
+	}
+
+	for (size_t i = 1; i < thread_count; i++)
+	{
+		workers.emplace_back([this] { WorkerLoop(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	if (workers.empty() || count == 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			job(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->job = &job;
+		job_count = count;
+		next_index = 0;
+		busy_workers = workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	RunJobs();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return busy_workers == 0; });
+	this->job = nullptr;
+}
+
+void ThreadPool::ParallelForStealing(size_t count, const std::function<void(size_t, size_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	assert(count <= UINT32_MAX);
+	const size_t thread_count = ThreadCount();
+	if (thread_count == 1 || count == 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			job(0, i);
+		}
+		return;
+	}
+
+	auto pack = [](uint64_t begin, uint64_t end) { return (begin << 32) | end; };
+
+	std::vector<StealRange> ranges(thread_count);
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		ranges[i].bounds = pack(count * i / thread_count, count * (i + 1) / thread_count);
+	}
+
+	ParallelFor(thread_count, [&](size_t worker)
+	{
+		auto& own = ranges[worker].bounds;
+		while (true)
+		{
+			// take from the front of our own slice, thieves only ever shrink its back
+			auto bounds = own.load();
+			while ((bounds >> 32) < (bounds & UINT32_MAX))
+			{
+				auto index = bounds >> 32;
+				if (own.compare_exchange_weak(bounds, pack(index + 1, bounds & UINT32_MAX)))
+				{
+					job(worker, index);
+					bounds = own.load();
+				}
+			}
+
+			// out of work, steal the back half of the first slice that has some left
+			bool stole = false;
+			for (size_t i = 1; i < thread_count && !stole; i++)
+			{
+				auto& victim = ranges[(worker + i) % thread_count].bounds;
+				auto victim_bounds = victim.load();
+				while (!stole && (victim_bounds >> 32) < (victim_bounds & UINT32_MAX))
+				{
+					auto begin = victim_bounds >> 32;
+					auto end = victim_bounds & UINT32_MAX;
+					auto middle = begin + (end - begin) / 2;
+					if (victim.compare_exchange_weak(victim_bounds, pack(begin, middle)))
+					{
+						own.store(pack(middle, end));
+						stole = true;
+					}
+				}
+			}
+
+			if (!stole)
+				return;
+		}
+	});
+}
+
+void ThreadPool::WorkerLoop()
+{
+	uint64_t seen_generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation != seen_generation; });
+			if (stopping)
+				return;
+
+			seen_generation = generation;
+		}
+
+		RunJobs();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy_workers == 0)
+		{
+			finished.notify_one();
+		}
+	}
+}
+
+void ThreadPool::RunJobs()
+{
+	for (auto index = next_index++; index < job_count; index = next_index++)
+	{
+		(*job)(index);
+	}
+}
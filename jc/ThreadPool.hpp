@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+// Fixed set of worker threads that run index ranges. The calling thread works on the
+// batch too, so a pool of one thread has no workers and runs everything inline.
+// Jobs must not call ParallelFor on the same pool.
+class ThreadPool
+{
+public:
+	// 0 picks one thread per core
+	explicit ThreadPool(size_t thread_count = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t ThreadCount() const { return workers.size() + 1; }
+
+	// runs job(0) .. job(count - 1) and returns once all of them are done, indices are
+	// handed out one at a time so uneven jobs still balance
+	void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+	// runs job(worker, 0) .. job(worker, count - 1). Every thread starts on its own slice of
+	// the indices and takes from its front, one that runs dry steals the back half of
+	// another slice. Neighbouring indices stay on one thread and there is no shared counter
+	// to fight over, which suits many small jobs. `worker` is below ThreadCount() and no two
+	// jobs with the same worker run at once, so it can pick per thread state.
+	void ParallelForStealing(size_t count, const std::function<void(size_t worker, size_t index)>& job);
+
+private:
+	// the indices a thread has left, begin in the high half and end in the low half so
+	// both move together in one compare and swap
+	struct alignas(64) StealRange
+	{
+		std::atomic<uint64_t> bounds{ 0 };
+	};
+
+	void WorkerLoop();
+	void RunJobs();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	const std::function<void(size_t)>* job = nullptr;
+	size_t job_count = 0;
+	std::atomic<size_t> next_index{ 0 };
+	// workers that have not finished the current batch yet
+	size_t busy_workers = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+};
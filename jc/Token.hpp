@@ -1,7 +1,11 @@
 #pragma once
 #include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "SymbolTable.hpp"
 
-enum class TokenType
+enum class TokenType : uint8_t
 {
 	None,
 	Identifier,
@@ -60,6 +64,7 @@ enum class TokenType
 	Null,
 	Extern,
 	Cpp,
+	Import,
 
 	// reserved types
 	I8,
@@ -80,18 +85,253 @@ enum class TokenType
 	EndOfFile
 };
 
+// decoded view of a single token, built on demand from the TokenBuffer
 struct Token
 {
 	TokenType type;
 	std::string_view value;
 	size_t line;
 	size_t column;
+	// only set for identifiers
+	SymbolId symbol;
 
-	explicit Token(TokenType type, const std::string_view& value, size_t line, size_t column)
+	explicit Token(TokenType type, const std::string_view& value, size_t line, size_t column, SymbolId symbol = INVALID_SYMBOL)
 		: type(type)
 		, value(value)
 		, line(line)
 		, column(column)
+		, symbol(symbol)
 	{
 	}
-};
\ No newline at end of file
+};
+
+// the bytes [begin, end) of an input were replaced by `text`
+struct TextEdit
+{
+	size_t begin;
+	size_t end;
+	std::string_view text;
+};
+
+// Struct-of-arrays token stream, 13 bytes per token instead of a 40 byte Token.
+// Offsets point at the first character of the token in the source, so the column is
+// recomputed from the source when it is asked for instead of being stored.
+// Tokens are always addressed by their absolute index. With SetWindow the buffer turns
+// into a ring that only keeps the most recent `window` tokens, which is all a parser
+// fed by Lexer::LexNext needs.
+struct TokenBuffer
+{
+	std::string_view source;
+	// identifiers are stored as SymbolIds and named through this table
+	const SymbolTable* symbols = nullptr;
+	std::vector<TokenType> kinds;
+	std::vector<uint32_t> offsets;
+	// length of the value, or the SymbolId for identifiers
+	std::vector<uint32_t> data;
+	std::vector<uint32_t> lines;
+	// absolute index -> storage slot, all ones while the buffer is unbounded
+	size_t mask = SIZE_MAX;
+	size_t count = 0;
+	// Splice leaves free slots where it replaced tokens, so the next edit close by only moves
+	// the tokens in between. Tokens from `gap` on are stored `gap_size` slots further, and
+	// `offset_shift` bytes and `line_shift` lines before where they are now
+	size_t gap = SIZE_MAX;
+	size_t gap_size = 0;
+	uint32_t offset_shift = 0;
+	uint32_t line_shift = 0;
+
+	// string literals and cpp blocks keep the delimiters out of their value
+	static uint32_t ValuePrefix(TokenType type)
+	{
+		switch (type)
+		{
+		case TokenType::StringLiteral: return 1; // "
+		case TokenType::Cpp: return 4; // cpp{
+		default: return 0;
+		}
+	}
+
+	// `window` has to be a power of two
+	void SetWindow(size_t window)
+	{
+		Clear();
+		mask = window - 1;
+		kinds.resize(window);
+		offsets.resize(window);
+		data.resize(window);
+		lines.resize(window);
+	}
+
+	bool IsWindowed() const { return mask != SIZE_MAX; }
+
+	// a buffer Splice changed is not pushed to
+	void Push(TokenType type, uint32_t offset, uint32_t length_or_symbol, uint32_t line)
+	{
+		if (!IsWindowed()) [[likely]]
+		{
+			kinds.push_back(type);
+			offsets.push_back(offset);
+			data.push_back(length_or_symbol);
+			lines.push_back(line);
+		}
+		else
+		{
+			auto slot = count & mask;
+			kinds[slot] = type;
+			offsets[slot] = offset;
+			data[slot] = length_or_symbol;
+			lines[slot] = line;
+		}
+		count++;
+	}
+
+	void Reserve(size_t count)
+	{
+		kinds.reserve(count);
+		offsets.reserve(count);
+		data.reserve(count);
+		lines.reserve(count);
+	}
+
+	void Clear()
+	{
+		kinds.clear();
+		offsets.clear();
+		data.clear();
+		lines.clear();
+		mask = SIZE_MAX;
+		count = 0;
+		gap = SIZE_MAX;
+		gap_size = 0;
+		offset_shift = 0;
+		line_shift = 0;
+	}
+
+	// replaces the tokens [begin, end) with the ones of `with`, which shares the symbols, and
+	// moves the tokens after them by `offset_shift` bytes and `line_shift` lines. Costs the
+	// tokens replaced and the ones between this splice and the last, the tokens after the
+	// gap move by changing its shift. Only for an unbounded buffer
+	void Splice(size_t begin, size_t end, const TokenBuffer& with, int64_t offset_shift, int64_t line_shift)
+	{
+		if (gap == SIZE_MAX)
+		{
+			gap = count;
+		}
+		MoveGap(end);
+		gap = begin;
+		gap_size += end - begin;
+		count -= end - begin;
+
+		if (gap_size < with.count)
+		{
+			// a little extra, so inserting a token at a time does not move the tail every time
+			GrowGap(with.count - gap_size + count / 16 + 64);
+		}
+		std::copy(with.kinds.begin(), with.kinds.begin() + with.count, kinds.begin() + gap);
+		std::copy(with.offsets.begin(), with.offsets.begin() + with.count, offsets.begin() + gap);
+		std::copy(with.data.begin(), with.data.begin() + with.count, data.begin() + gap);
+		std::copy(with.lines.begin(), with.lines.begin() + with.count, lines.begin() + gap);
+		gap += with.count;
+		gap_size -= with.count;
+		count += with.count;
+
+		this->offset_shift += (uint32_t)offset_shift;
+		this->line_shift += (uint32_t)line_shift;
+	}
+
+	size_t Count() const { return count; }
+
+	size_t Slot(size_t index) const { return (index < gap ? index : index + gap_size) & mask; }
+
+	TokenType Kind(size_t index) const { return kinds[Slot(index)]; }
+
+	uint32_t Offset(size_t index) const
+	{
+		if (index < gap) [[likely]]
+			return offsets[index & mask];
+
+		return offsets[index + gap_size] + offset_shift;
+	}
+
+	SymbolId Symbol(size_t index) const
+	{
+		return Kind(index) == TokenType::Identifier ? data[Slot(index)] : INVALID_SYMBOL;
+	}
+
+	std::string_view Value(size_t index) const
+	{
+		auto slot = Slot(index);
+		if (kinds[slot] == TokenType::Identifier)
+			return symbols->Name(data[slot]);
+
+		return source.substr(Offset(index) + ValuePrefix(kinds[slot]), data[slot]);
+	}
+
+	size_t Line(size_t index) const
+	{
+		if (index < gap) [[likely]]
+			return lines[index & mask];
+
+		// EndOfFile is on line 0 however the lines before it moved
+		auto slot = index + gap_size;
+		return kinds[slot] == TokenType::EndOfFile ? 0 : (uint32_t)(lines[slot] + line_shift);
+	}
+
+	// offset of the first character on the line of the token
+	size_t LineStart(size_t index) const
+	{
+		size_t offset = Offset(index);
+		while (offset > 0 && source[offset - 1] != '\n')
+		{
+			offset--;
+		}
+		return offset;
+	}
+
+	size_t Column(size_t index) const
+	{
+		if (Line(index) == 0)
+			return 0;
+
+		return Offset(index) - LineStart(index);
+	}
+
+	Token Get(size_t index) const
+	{
+		return Token(Kind(index), Value(index), Line(index), Column(index), Symbol(index));
+	}
+
+private:
+	// the tokens between the gap and `to` cross it, which gives them its shift or takes it away
+	void MoveGap(size_t to)
+	{
+		for (; gap < to; gap++)
+		{
+			auto from = gap + gap_size;
+			kinds[gap] = kinds[from];
+			offsets[gap] = offsets[from] + offset_shift;
+			data[gap] = data[from];
+			lines[gap] = kinds[from] == TokenType::EndOfFile ? 0 : lines[from] + line_shift;
+		}
+		for (; gap > to; gap--)
+		{
+			auto from = gap - 1;
+			auto slot = from + gap_size;
+			kinds[slot] = kinds[from];
+			offsets[slot] = offsets[from] - offset_shift;
+			data[slot] = data[from];
+			lines[slot] = kinds[from] == TokenType::EndOfFile ? 0 : lines[from] - line_shift;
+		}
+	}
+
+	// the tokens after the gap move up by `extra` slots
+	void GrowGap(size_t extra)
+	{
+		auto at = gap + gap_size;
+		kinds.insert(kinds.begin() + at, extra, TokenType::None);
+		offsets.insert(offsets.begin() + at, extra, 0);
+		data.insert(data.begin() + at, extra, 0);
+		lines.insert(lines.begin() + at, extra, 0);
+		gap_size += extra;
+	}
+};
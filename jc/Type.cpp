@@ -1,119 +1,54 @@
 #include "Type.hpp"
 
-Type::Type(TypeID id, const std::string_view& name)
-	: id(id)
-	, name(name)
+TypeTable::TypeTable()
 {
-
+	Clear();
 }
 
-bool Type::IsNumeric()
+Type TypeTable::Create(SymbolId symbol, std::string_view name)
 {
-	return IsIntegral() || IsFloatingPoint();
-}
-
-bool Type::IsIntegral()
-{
-	return id >= TYPE_INT8 && id <= TYPE_UINT64;
-}
-
-bool Type::IsFloatingPoint()
-{
-	return id >= TYPE_FLOAT && id <= TYPE_DOUBLE;
-}
-
-bool Type::IsBool()
-{
-	return id == TYPE_BOOL;
-}
+	if (Find(symbol).id != TYPE_UNKNOWN)
+	{
+		return Type{};
+	}
 
-bool Type::IsString()
-{
-	return id == TYPE_STRING;
+	auto type = Type{ (TypeID)names.size() };
+	names.push_back(name);
+	symbols.push_back(symbol);
+	if (symbol >= by_symbol.size())
+	{
+		by_symbol.resize((size_t)symbol + 1, TYPE_UNKNOWN);
+	}
+	by_symbol[symbol] = type.id;
+	return type;
 }
 
-bool Type::IsVoid()
+std::string_view TypeTable::ToString(Type type) const
 {
-	return id == TYPE_VOID;
-}
+	switch (type.id)
+	{
+	case TYPE_INT8: return "i8";
+	case TYPE_INT16: return "i16";
+	case TYPE_INT32: return "i32";
+	case TYPE_INT64: return "i64";
+	case TYPE_UINT8: return "u8";
+	case TYPE_UINT16: return "u16";
+	case TYPE_UINT32: return "u32";
+	case TYPE_UINT64: return "u64";
+	case TYPE_FLOAT: return "f32";
+	case TYPE_DOUBLE: return "f64";
+	case TYPE_BOOL: return "bool";
+	case TYPE_STRING: return "str";
+	case TYPE_CHAR: return "char";
+	case TYPE_VOID: return "void";
+	}
 
-bool Type::IsPrimitive()
-{
-	return id > TYPE_UNKNOWN && id <= TYPE_VOID;
+	return Name(type);
 }
 
-bool Type::IsPrimitiveCompatible(const Type& other)
+void TypeTable::Clear()
 {
-	if (*this == other) return true;
-
-	switch (other.id)
-	{
-	case TypeID::TYPE_VOID:
-		return id == TypeID::TYPE_VOID;
-	case TypeID::TYPE_INT8:
-		return
-			id == TypeID::TYPE_INT8 || id == TypeID::TYPE_UINT8;
-	case TypeID::TYPE_INT16:
-		return
-			id == TypeID::TYPE_INT16 || id == TypeID::TYPE_UINT16 ||
-			id == TypeID::TYPE_INT8 || id == TypeID::TYPE_UINT8;
-	case TypeID::TYPE_INT32:
-		return
-			id == TypeID::TYPE_INT32 || id == TypeID::TYPE_UINT32 ||
-			id == TypeID::TYPE_INT16 || id == TypeID::TYPE_UINT16 ||
-			id == TypeID::TYPE_INT8 || id == TypeID::TYPE_UINT8;
-
-	case TypeID::TYPE_INT64:
-		return
-			id == TypeID::TYPE_INT64 || id == TypeID::TYPE_UINT64 ||
-			id == TypeID::TYPE_INT32 || id == TypeID::TYPE_UINT32 ||
-			id == TypeID::TYPE_INT16 || id == TypeID::TYPE_UINT16 ||
-			id == TypeID::TYPE_INT8 || id == TypeID::TYPE_UINT8;
-
-	case TypeID::TYPE_FLOAT:
-		return
-			id == TypeID::TYPE_FLOAT ||
-			id == TypeID::TYPE_INT64 || id == TypeID::TYPE_UINT64 ||
-			id == TypeID::TYPE_INT32 || id == TypeID::TYPE_UINT32 ||
-			id == TypeID::TYPE_INT16 || id == TypeID::TYPE_UINT16 ||
-			id == TypeID::TYPE_INT8 || id == TypeID::TYPE_UINT8;
-
-	case TypeID::TYPE_DOUBLE:
-		return
-			id == TypeID::TYPE_DOUBLE ||
-			id == TypeID::TYPE_FLOAT ||
-			id == TypeID::TYPE_INT64 || id == TypeID::TYPE_UINT64 ||
-			id == TypeID::TYPE_INT32 || id == TypeID::TYPE_UINT32 ||
-			id == TypeID::TYPE_INT16 || id == TypeID::TYPE_UINT16 ||
-			id == TypeID::TYPE_INT8 || id == TypeID::TYPE_UINT8;
-
-	case TypeID::TYPE_BOOL:
-		return id == TypeID::TYPE_BOOL;
-
-	case TypeID::TYPE_STRING:
-		return id == TypeID::TYPE_STRING;
-
-	case TypeID::TYPE_UINT8:
-		return id == TypeID::TYPE_UINT8;
-
-	case TypeID::TYPE_UINT16:
-		return
-			id == TypeID::TYPE_UINT16 ||
-			id == TypeID::TYPE_UINT8;
-
-	case TypeID::TYPE_UINT32:
-		return
-			id == TypeID::TYPE_UINT32 ||
-			id == TypeID::TYPE_UINT16 ||
-			id == TypeID::TYPE_UINT8;
-
-	case TypeID::TYPE_UINT64:
-		return
-			id == TypeID::TYPE_UINT64 ||
-			id == TypeID::TYPE_UINT32 ||
-			id == TypeID::TYPE_UINT16 ||
-			id == TypeID::TYPE_UINT8;
-	}
-
-	return false;
+	names.assign(PRIMITIVE_TYPE_NAMES.begin(), PRIMITIVE_TYPE_NAMES.end());
+	symbols.assign(PRIMITIVE_TYPE_COUNT, INVALID_SYMBOL);
+	by_symbol.clear();
 }
@@ -1,8 +1,11 @@
 #pragma once
 #include <string_view>
+#include <array>
+#include <cstdint>
+#include "SymbolTable.hpp"
 
 
-enum TypeID 
+enum TypeID : uint32_t
 {
 	TYPE_UNKNOWN = 0,
 
@@ -27,43 +30,147 @@ enum TypeID
 	TYPE_VOID
 };
 
+// struct types get ids from here on, handed out by TypeTable
+constexpr uint32_t PRIMITIVE_TYPE_COUNT = TYPE_VOID + 1;
+
+// the C++ names of the primitives, every TypeTable starts out with them
+constexpr std::array<std::string_view, PRIMITIVE_TYPE_COUNT> PRIMITIVE_TYPE_NAMES = []()
+{
+	std::array<std::string_view, PRIMITIVE_TYPE_COUNT> names{};
+	names[TYPE_INT8] = "int8_t";
+	names[TYPE_INT16] = "int16_t";
+	names[TYPE_INT32] = "int32_t";
+	names[TYPE_INT64] = "int64_t";
+	names[TYPE_UINT8] = "uint8_t";
+	names[TYPE_UINT16] = "uint16_t";
+	names[TYPE_UINT32] = "uint32_t";
+	names[TYPE_UINT64] = "uint64_t";
+	names[TYPE_FLOAT] = "float";
+	names[TYPE_DOUBLE] = "double";
+	names[TYPE_STRING] = "std::string";
+	names[TYPE_CHAR] = "char";
+	names[TYPE_BOOL] = "bool";
+	names[TYPE_VOID] = "void";
+	return names;
+}();
+
+// IMPLICIT_CONVERSIONS[wants] has bit `is` set when a primitive `is` converts to `wants`
+// without a cast: integers widen to integers of the same or larger size (an unsigned
+// target only takes unsigned ones), every integer converts to float and double, and float
+// widens to double.
+constexpr std::array<uint32_t, PRIMITIVE_TYPE_COUNT> IMPLICIT_CONVERSIONS = []()
+{
+	constexpr TypeID signed_types[] = { TYPE_INT8, TYPE_INT16, TYPE_INT32, TYPE_INT64 };
+	constexpr TypeID unsigned_types[] = { TYPE_UINT8, TYPE_UINT16, TYPE_UINT32, TYPE_UINT64 };
+
+	std::array<uint32_t, PRIMITIVE_TYPE_COUNT> conversions{};
+	for (uint32_t id = TYPE_INT8; id < PRIMITIVE_TYPE_COUNT; id++)
+	{
+		conversions[id] = 1u << id;
+	}
+
+	uint32_t all_integers = 0;
+	for (int size = 0; size < 4; size++)
+	{
+		for (int smaller = 0; smaller <= size; smaller++)
+		{
+			conversions[signed_types[size]] |= (1u << signed_types[smaller]) | (1u << unsigned_types[smaller]);
+			conversions[unsigned_types[size]] |= 1u << unsigned_types[smaller];
+		}
+		all_integers |= (1u << signed_types[size]) | (1u << unsigned_types[size]);
+	}
+
+	conversions[TYPE_FLOAT] |= all_integers;
+	conversions[TYPE_DOUBLE] |= all_integers | (1u << TYPE_FLOAT);
+	return conversions;
+}();
+
+// A type is a 32 bit handle, a primitive TypeID or the id TypeTable gave a struct.
+// Names live in the TypeTable, so comparing or copying a type is an integer operation.
 struct Type
 {
 	TypeID id;
-	std::string_view name;
 
-	Type() 
+	constexpr Type() 
 		: id(TYPE_UNKNOWN)
 	{}
-	explicit Type(TypeID id, const std::string_view& name);
-
-	bool IsNumeric();
-	bool IsIntegral();
-	bool IsFloatingPoint();
-	bool IsBool();
-	bool IsString();
-	bool IsVoid();
-	bool IsPrimitive();
-
-	bool IsPrimitiveCompatible(const Type& other);
-
-	static Type get_int8_t() { return Type{ TYPE_INT8, "int8_t" }; }
-	static Type get_int16_t() { return Type{ TYPE_INT16, "int16_t" }; }
-	static Type get_int32_t() { return Type{ TYPE_INT32, "int32_t" }; }
-	static Type get_int64_t() { return Type{ TYPE_INT64, "int64_t" }; }
-	static Type get_uint8_t() { return Type{ TYPE_UINT8, "uint8_t" }; }
-	static Type get_uint16_t() { return Type{ TYPE_UINT16, "uint16_t" }; }
-	static Type get_uint32_t() { return Type{ TYPE_UINT32, "uint32_t" }; }
-	static Type get_uint64_t() { return Type{ TYPE_UINT64, "uint64_t" }; }
-	static Type get_float() { return Type{ TYPE_FLOAT, "float" }; }
-	static Type get_double() { return Type{ TYPE_DOUBLE, "double" }; }
-	static Type get_string() { return Type{ TYPE_STRING, "std::string" }; }
-	static Type get_char() { return Type{ TYPE_CHAR, "char" }; }
-	static Type get_bool() { return Type{ TYPE_BOOL, "bool" }; }
-	static Type get_void() { return Type{ TYPE_VOID, "void" }; }
-
-	bool operator==(const Type& other) const
+	constexpr explicit Type(TypeID id)
+		: id(id)
+	{}
+
+	constexpr bool IsNumeric() const { return IsIntegral() || IsFloatingPoint(); }
+	constexpr bool IsIntegral() const { return id >= TYPE_INT8 && id <= TYPE_UINT64; }
+	constexpr bool IsFloatingPoint() const { return id >= TYPE_FLOAT && id <= TYPE_DOUBLE; }
+	constexpr bool IsBool() const { return id == TYPE_BOOL; }
+	constexpr bool IsString() const { return id == TYPE_STRING; }
+	constexpr bool IsVoid() const { return id == TYPE_VOID; }
+	constexpr bool IsPrimitive() const { return id > TYPE_UNKNOWN && id <= TYPE_VOID; }
+
+	// both types have to be primitives
+	constexpr bool IsPrimitiveCompatible(const Type& other) const
+	{
+		return (IMPLICIT_CONVERSIONS[other.id] >> id) & 1;
+	}
+
+	static constexpr Type get_int8_t() { return Type{ TYPE_INT8 }; }
+	static constexpr Type get_int16_t() { return Type{ TYPE_INT16 }; }
+	static constexpr Type get_int32_t() { return Type{ TYPE_INT32 }; }
+	static constexpr Type get_int64_t() { return Type{ TYPE_INT64 }; }
+	static constexpr Type get_uint8_t() { return Type{ TYPE_UINT8 }; }
+	static constexpr Type get_uint16_t() { return Type{ TYPE_UINT16 }; }
+	static constexpr Type get_uint32_t() { return Type{ TYPE_UINT32 }; }
+	static constexpr Type get_uint64_t() { return Type{ TYPE_UINT64 }; }
+	static constexpr Type get_float() { return Type{ TYPE_FLOAT }; }
+	static constexpr Type get_double() { return Type{ TYPE_DOUBLE }; }
+	static constexpr Type get_string() { return Type{ TYPE_STRING }; }
+	static constexpr Type get_char() { return Type{ TYPE_CHAR }; }
+	static constexpr Type get_bool() { return Type{ TYPE_BOOL }; }
+	static constexpr Type get_void() { return Type{ TYPE_VOID }; }
+
+	constexpr bool operator==(const Type& other) const
 	{
 		return id == other.id;
 	}
-};
\ No newline at end of file
+};
+
+// Owns the struct types of a compile. A struct gets its handle once, when it is declared,
+// everything after that compares handles.
+class TypeTable
+{
+public:
+	TypeTable();
+
+	// a new handle for the struct `symbol`, TYPE_UNKNOWN when it already has one
+	Type Create(SymbolId symbol, std::string_view name);
+	// the struct type named `symbol`, TYPE_UNKNOWN when there is none
+	Type Find(SymbolId symbol) const
+	{
+		return symbol < by_symbol.size() ? Type{ by_symbol[symbol] } : Type{};
+	}
+
+	// the name C++ knows the type by, int32_t for i32 and the struct name for structs
+	std::string_view Name(Type type) const { return type.id < names.size() ? names[type.id] : std::string_view(); }
+	// the name as it is written in source, i32 for i32
+	std::string_view ToString(Type type) const;
+	// INVALID_SYMBOL for primitives
+	SymbolId Symbol(Type type) const { return type.id < symbols.size() ? symbols[type.id] : INVALID_SYMBOL; }
+
+	// is == wants or a primitive `is` that implicitly converts to a primitive `wants`
+	static constexpr bool IsCompatible(Type is, Type wants)
+	{
+		if (is == wants)
+			return true;
+		// only primitives convert, any struct id is past the end of the matrix
+		return is.IsPrimitive() && wants.IsPrimitive() && is.IsPrimitiveCompatible(wants);
+	}
+
+	size_t Count() const { return names.size(); }
+	void Clear();
+
+private:
+	// indexed by TypeID
+	std::vector<std::string_view> names;
+	std::vector<SymbolId> symbols;
+	// indexed by SymbolId, TYPE_UNKNOWN for names that are not a type
+	std::vector<TypeID> by_symbol;
+};
@@ -2,232 +2,117 @@
 #include <cassert>
 
 TypeChecker::TypeChecker(Context* context)
-	: context(context)
+	: ASTVisitor(context)
 {
 }
 
 void TypeChecker::Check()
 {
-	CheckDataType();
+	WalkFunctions();
 }
 
-void TypeChecker::CheckDataType(Expression* expression)
+void TypeChecker::CheckArguments(SymbolId function_name, const std::vector<Argument*>& args)
 {
-	switch (expression->node_type)
+	auto function = context->GetFunctionPrototype(function_name);
+	int i = 0;
+	for (auto& arg : args)
 	{
-	case ASTNodeType::NumberLiteral:
-	case ASTNodeType::StringLiteral:
-	case ASTNodeType::Variable:
-	case ASTNodeType::MemberAccessExpression:
-		break;
-
-	case ASTNodeType::CallExpression:
-	{
-		auto call = static_cast<CallExpression*>(expression);
-		auto function = context->GetFunctionPrototype(call->name);
-		int i = 0;
-		for (auto& arg : call->args)
+		if (function->params[i].data_type != arg->data_type)
 		{
-			CheckDataType(arg);
-			if (function->params[i].data_type != arg->data_type)
+			if (IsTypeCompatible(arg->data_type, function->params[i].data_type))
 			{
-				if (IsTypeCompatible(arg->data_type, function->params[i].data_type))
-				{
-					context->Warning("Implicit Conversion: " + std::string(TypeToString(arg->data_type)) + " -> " + 
-						std::string(TypeToString(function->params[i].data_type)), arg->line, arg->column);
-				}
-				else
-				{
-					context->Error("Type Mismatch: " + std::string(TypeToString(arg->data_type)) + " != " +
-						std::string(TypeToString(function->params[i].data_type)), arg->line, arg->column);
-				}
-			}
-			i++;
-		}
-	}
-	break;
-
-	case ASTNodeType::BinaryExpression:
-	{
-		auto be = static_cast<BinaryExpression*>(expression);
-		CheckDataType(be->lhs);
-		CheckDataType(be->rhs);
-		if (be->lhs->data_type != be->rhs->data_type)
-		{
-			if (IsTypeCompatible(be->lhs->data_type, be->rhs->data_type))
-			{
-				context->Warning("Implicit Conversion: " + std::string(TypeToString(be->lhs->data_type)) + " -> " +
-					std::string(TypeToString(be->rhs->data_type)), be->lhs->line, be->lhs->column);
+				Warning("Implicit Conversion: " + std::string(context->types.ToString(arg->data_type)) + " -> " + 
+					std::string(context->types.ToString(function->params[i].data_type)), arg->line, arg->column);
 			}
 			else
 			{
-				context->Error("Type Mismatch: " + std::string(TypeToString(be->lhs->data_type)) + " != " +
-					std::string(TypeToString(be->rhs->data_type)), be->lhs->line, be->lhs->column);
+				Error("Type Mismatch: " + std::string(context->types.ToString(arg->data_type)) + " != " +
+					std::string(context->types.ToString(function->params[i].data_type)), arg->line, arg->column);
 			}
 		}
+		i++;
 	}
-	break;
-
-	case ASTNodeType::AssignmentExpression:
-	{
-		auto ae = static_cast<AssignmentExpression*>(expression);
-		CheckDataType(ae->lhs);
-		CheckDataType(ae->rhs);
-		if (ae->lhs->data_type != ae->rhs->data_type)
-		{
-			if (IsTypeCompatible(ae->rhs->data_type, ae->lhs->data_type))
-			{
-				context->Warning("Implicit Conversion: " + std::string(TypeToString(ae->rhs->data_type)) + " -> " +
-					std::string(TypeToString(ae->lhs->data_type)), ae->lhs->line, ae->lhs->column);
-			}
-			else
-			{
-				context->Error("Type Mismatch: " + std::string(TypeToString(ae->rhs->data_type)) + " != " +
-					std::string(TypeToString(ae->lhs->data_type)), ae->lhs->line, ae->lhs->column);
-			}
-		}
-	}
-	break;
+}
 
-	case ASTNodeType::Argument:
-	{
-		CheckDataType(static_cast<Argument*>(expression)->expression);
-		break;
-	}
+void TypeChecker::Leave(CallExpression* call)
+{
+	CheckArguments(call->symbol, call->args);
+}
 
-	default:
-		assert(false);
-		break;
-	}
+void TypeChecker::Leave(CallStatement* call)
+{
+	CheckArguments(call->symbol, call->args);
 }
 
-void TypeChecker::CheckDataType(Statement* statement)
+void TypeChecker::Leave(BinaryExpression* be)
 {
-	switch (statement->node_type)
+	if (be->lhs->data_type != be->rhs->data_type)
 	{
-	case ASTNodeType::CallStatement:
-	{
-		auto call = static_cast<CallStatement*>(statement);
-		auto function = context->GetFunctionPrototype(call->name);
-		int i = 0;
-		for (auto& arg : call->args)
+		if (IsTypeCompatible(be->lhs->data_type, be->rhs->data_type))
 		{
-			CheckDataType(arg);
-			if (function->params[i].data_type != arg->data_type)
-			{
-				if (IsTypeCompatible(arg->data_type, function->params[i].data_type))
-				{
-					context->Warning("Implicit Conversion: " + std::string(TypeToString(arg->data_type)) + " -> " +
-						std::string(TypeToString(function->params[i].data_type)), arg->line, arg->column);
-				}
-				else
-				{
-					context->Error("Type Mismatch: " + std::string(TypeToString(arg->data_type)) + " != " +
-						std::string(TypeToString(function->params[i].data_type)), arg->line, arg->column);
-				}
-			}
-			i++;
+			Warning("Implicit Conversion: " + std::string(context->types.ToString(be->lhs->data_type)) + " -> " +
+				std::string(context->types.ToString(be->rhs->data_type)), be->lhs->line, be->lhs->column);
 		}
-	}
-	break;
-	case ASTNodeType::ExpressionStatement:
-		CheckDataType(static_cast<ExpressionStatement*>(statement)->expression);
-		break;
-	case ASTNodeType::ReturnStatement:
-		CheckDataType(static_cast<ReturnStatement*>(statement)->expression);
-		break;
-	case ASTNodeType::DeclarationStatement:
-	{
-		auto ds = static_cast<DeclarationStatement*>(statement);
-		if (ds->expression)
+		else
 		{
-			CheckDataType(ds->expression);
-			if (ds->data_type != ds->expression->data_type)
-			{
-				if (IsTypeCompatible(ds->data_type, ds->expression->data_type))
-				{
-					context->Warning("Implicit Conversion: " + std::string(TypeToString(ds->data_type)) + " -> " +
-						std::string(TypeToString(ds->expression->data_type)), ds->line, ds->column);
-				}
-				else
-				{
-					context->Error("Type Mismatch: " + std::string(TypeToString(ds->data_type)) + " != " +
-						std::string(TypeToString(ds->expression->data_type)), ds->line, ds->column);
-				}
-			}
+			Error("Type Mismatch: " + std::string(context->types.ToString(be->lhs->data_type)) + " != " +
+				std::string(context->types.ToString(be->rhs->data_type)), be->lhs->line, be->lhs->column);
 		}
 	}
-	break;
-	case ASTNodeType::AssignmentStatement:
+}
+
+void TypeChecker::Leave(AssignmentExpression* ae)
+{
+	if (ae->lhs->data_type != ae->rhs->data_type)
 	{
-		auto as = static_cast<AssignmentStatement*>(statement);
-		CheckDataType(as->lhs);
-		CheckDataType(as->rhs);
-		if (as->lhs->data_type != as->rhs->data_type)
+		if (IsTypeCompatible(ae->rhs->data_type, ae->lhs->data_type))
 		{
-			if (IsTypeCompatible(as->lhs->data_type, as->rhs->data_type))
-			{
-				context->Warning("Implicit Conversion: " + std::string(TypeToString(as->lhs->data_type)) + " -> " +
-					std::string(TypeToString(as->rhs->data_type)), as->lhs->line, as->lhs->column);
-			}
-			else
-			{
-				context->Error("Type Mismatch: " + std::string(TypeToString(as->lhs->data_type)) + " != " +
-					std::string(TypeToString(as->rhs->data_type)), as->lhs->line, as->lhs->column);
-			}
+			Warning("Implicit Conversion: " + std::string(context->types.ToString(ae->rhs->data_type)) + " -> " +
+				std::string(context->types.ToString(ae->lhs->data_type)), ae->lhs->line, ae->lhs->column);
+		}
+		else
+		{
+			Error("Type Mismatch: " + std::string(context->types.ToString(ae->rhs->data_type)) + " != " +
+				std::string(context->types.ToString(ae->lhs->data_type)), ae->lhs->line, ae->lhs->column);
 		}
-	}
-	break;
-	case ASTNodeType::CppBlock:
-	case ASTNodeType::StructDefinationStatement:
-	case ASTNodeType::ExternFunctionStatement:
-	case ASTNodeType::ExternVariableStatement:
-		break;
-	default:
-		assert(false);
-		break;
 	}
 }
 
-void TypeChecker::CheckDataType()
+void TypeChecker::Leave(DeclarationStatement* ds)
 {
-	for (auto& function : context->program->functions)
+	if (ds->expression && ds->data_type != ds->expression->data_type)
 	{
-		for (auto& statement : function->body->statements)
+		if (IsTypeCompatible(ds->data_type, ds->expression->data_type))
 		{
-			CheckDataType(statement);
+			Warning("Implicit Conversion: " + std::string(context->types.ToString(ds->data_type)) + " -> " +
+				std::string(context->types.ToString(ds->expression->data_type)), ds->line, ds->column);
+		}
+		else
+		{
+			Error("Type Mismatch: " + std::string(context->types.ToString(ds->data_type)) + " != " +
+				std::string(context->types.ToString(ds->expression->data_type)), ds->line, ds->column);
 		}
 	}
 }
 
-bool TypeChecker::IsTypeCompatible(Type is, Type wants)
+void TypeChecker::Leave(AssignmentStatement* as)
 {
-	if (is == wants)
+	if (as->lhs->data_type != as->rhs->data_type)
 	{
-		return true;
-	}
-
-	if (is.IsPrimitive() && wants.IsPrimitive())
-	{
-		if (is.IsPrimitiveCompatible(wants))
+		if (IsTypeCompatible(as->lhs->data_type, as->rhs->data_type))
 		{
-			return true;
+			Warning("Implicit Conversion: " + std::string(context->types.ToString(as->lhs->data_type)) + " -> " +
+				std::string(context->types.ToString(as->rhs->data_type)), as->lhs->line, as->lhs->column);
 		}
-	}
-	else
-	{
-		if (is.IsPrimitive() || wants.IsPrimitive()) return false;
-
-		auto is_id = context->GetType(is.name);
-		auto wants_id = context->GetType(wants.name);
-
-		if (is_id == wants_id)
+		else
 		{
-			return true;
+			Error("Type Mismatch: " + std::string(context->types.ToString(as->lhs->data_type)) + " != " +
+				std::string(context->types.ToString(as->rhs->data_type)), as->lhs->line, as->lhs->column);
 		}
-
-		return false;
 	}
+}
 
-	return false;
+bool TypeChecker::IsTypeCompatible(Type is, Type wants)
+{
+	return TypeTable::IsCompatible(is, wants);
 }
@@ -1,8 +1,11 @@
 #pragma once
 #include "AST.hpp"
 #include "Parser.hpp"
+#include "ASTVisitor.hpp"
 
-class TypeChecker
+// Type mismatches and implicit conversions. A compile cache replays the messages of
+// unchanged functions, a new or reworded one means bumping COMPILE_CACHE_VERSION
+class TypeChecker : public ASTVisitor<TypeChecker>
 {
 public:
 	explicit TypeChecker(Context* context);
@@ -10,11 +13,19 @@ public:
 	void Check();
 
 private:
-	void CheckDataType(Expression* expression);
-	void CheckDataType(Statement* statement);
-	void CheckDataType();
+	friend class ASTVisitor<TypeChecker>;
 
-	bool IsTypeCompatible(Type is, Type wants);
+	// a member access has nothing to check below it
+	bool Enter(MemberAccessExpression*) { return false; }
+
+	// checks run once the children are done, so the operand types are final
+	void Leave(CallExpression* call);
+	void Leave(CallStatement* call);
+	void Leave(BinaryExpression* binary);
+	void Leave(AssignmentExpression* assignment);
+	void Leave(DeclarationStatement* declaration);
+	void Leave(AssignmentStatement* assignment);
 
-	Context* context;
+	void CheckArguments(SymbolId function_name, const std::vector<Argument*>& args);
+	bool IsTypeCompatible(Type is, Type wants);
 };
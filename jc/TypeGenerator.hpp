@@ -1,8 +1,11 @@
 #pragma once
 #include "AST.hpp"
 #include "Parser.hpp"
+#include "ASTVisitor.hpp"
 
-class TypeGenertaor
+// The type of every expression, which the checker reports and CodeGen writes. What
+// either makes of a type differently is stale in a compile cache, see COMPILE_CACHE_VERSION
+class TypeGenertaor : public ASTVisitor<TypeGenertaor>
 {
 public:
 	explicit TypeGenertaor(Context* context);
@@ -10,10 +13,15 @@ public:
 	void Generate();
 
 private:
-	void GenerateDataType(Expression* expression);
-	void GenerateDataType(Statement* statement);
-	void GenerateDataType(Function* function);
-	void GenerateDataType();
+	friend class ASTVisitor<TypeGenertaor>;
 
-	Context* context;
+	// children are typed before their parent, so every hook can read its operands
+	void Leave(NumberLiteral* number);
+	void Leave(StringLiteral* string_literal);
+	void Leave(Variable* variable);
+	void Leave(CallExpression* call);
+	void Leave(BinaryExpression* binary);
+	void Leave(UnaryExpression* unary);
+	void Leave(AssignmentExpression* assignment);
+	void Leave(Argument* argument);
 };
@@ -1,32 +1,6 @@
 #include "Utils.hpp"
 #include <iostream>
 
-std::string_view read_file_into_string_view(const char* path)
-{
-	FILE* file;
-	fopen_s(&file, path, "rb");
-	if (!file)
-	{
-		return std::string_view(nullptr, 0);
-	}
-
-	fseek(file, 0, SEEK_END);
-	auto size = ftell(file);
-	fseek(file, 0, SEEK_SET);
-
-	char* buffer = new char[size + 1];
-	if (!buffer)
-	{
-		fclose(file);
-		return std::string_view(nullptr, 0);
-	}
-	memset(buffer, 0, size + 1ull);
-	fread_s(buffer, size, size, 1, file);
-	buffer[size] = 0;
-	fclose(file);
-	return std::string_view(buffer, size);
-}
-
 TimeIt::TimeIt(const std::string& name)
 	: name(name)
 {
@@ -1,9 +1,7 @@
 #pragma once
-#include <string_view>
+#include <string>
 #include <chrono>
 
-std::string_view read_file_into_string_view(const char* path);
-
 class TimeIt
 {
 public:
@@ -19,8 +19,9 @@ struct Value
 		unsigned long long int unsigned_integer;
 	};
 
-	// stream output
-	friend std::ostream& operator<<(std::ostream& out, const Value& value)
+	// text output, to an std::ostream or an OutputBuffer
+	template<typename Out>
+	friend Out& operator<<(Out& out, const Value& value)
 	{
 		switch (value.type.id)
 		{
@@ -7,14 +7,77 @@
 #include "CodeGen.hpp"
 #include "TypeChecker.hpp"
 #include "TypeGenerator.hpp"
+#include "ModuleGraph.hpp"
+#include "Batch.hpp"
+#include "Bench.hpp"
+#include "Daemon.hpp"
+#include "Options.hpp"
+#include "SelfTest.hpp"
 #include <cassert>
+#include <cstring>
 
-int main()
+int main(int argc, char** argv)
 {
-	auto context = new Context("test.jin");
-	context->print_timing = true;
-	context->Compile();
-	context->PrintMessages();
-	system("pause");
-	return 0;
+	if (argc >= 3 && std::strcmp(argv[1], "--daemon") == 0)
+	{
+		Daemon daemon(argv[2]);
+		return daemon.Run() ? 0 : 1;
+	}
+	if (argc >= 3 && std::strcmp(argv[1], "--connect") == 0)
+	{
+		// the rest of the arguments are compiled by the daemon as if they were given here
+		auto code = Daemon::Request(argv[2], std::vector<const char*>(argv + 3, argv + argc));
+		return code < 0 ? 1 : code;
+	}
+
+	if (argc >= 2 && std::strcmp(argv[1], "--self-test") == 0)
+	{
+		SelfTest test(argc >= 3 ? argv[2] : "test.jin");
+		return test.Run() ? 0 : 1;
+	}
+
+	if (argc >= 2 && std::strcmp(argv[1], "--bench") == 0)
+	{
+		Bench bench(std::vector<const char*>(argv + 2, argv + argc));
+		return bench.Run() ? 0 : 1;
+	}
+
+	Options options;
+	options.Parse(std::vector<const char*>(argv + 1, argv + argc));
+	auto configure = [&](Context* context)
+	{
+		options.Configure(context);
+	};
+
+	if (options.file_paths.size() > 1)
+	{
+		if (options.output_path)
+		{
+			std::cout << "Error: -o takes a single input, every file of a batch is written next to it" << std::endl;
+			return 1;
+		}
+
+		Batch batch(options.file_paths, options.thread_count, configure);
+		batch.print_timing = true;
+		return batch.Run() ? 0 : 1;
+	}
+
+	auto context = new Context(options.file_paths[0]);
+	configure(context);
+	context->output_path = options.output_path;
+	bool failed;
+	if (options.stream_tokens)
+	{
+		context->Compile();
+		context->PrintMessages();
+		failed = !context->errors.empty();
+	}
+	else
+	{
+		ModuleGraph graph(context);
+		graph.Build();
+		graph.PrintMessages();
+		failed = graph.HasErrors();
+	}
+	return failed ? 1 : 0;
 }